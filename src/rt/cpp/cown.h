@@ -26,11 +26,33 @@ private:
   friend class cown_ptr;
 };
 
+/**
+ * Internal Verona runtime cown for a value of type T.
+ */
+template<typename T>
+class ActualCown : public verona::rt::VCown<ActualCown<T>>
+{
+private:
+  T value;
+
+public:
+  template<typename... Args>
+  ActualCown(Args&&... ts) : value(std::forward<Args>(ts)...)
+  {}
+
+  template<typename TT>
+  friend class acquired_cown;
+};
+
 /**
  * Smart pointer to represent shared access to a cown.
  * Can only be used asychronously with `when` to get
  * underlying access.
  *
+ * A `cown_ptr<const T>`, returned by `read`, refers to the same cown, but a
+ * `when` on it only acquires the cown for reading, so may run at the same
+ * time as other behaviours that read it.
+ *
  * Note using lower case name to match C++ std library
  * as this is one of the exposed types.
  */
@@ -38,32 +60,17 @@ template<typename T>
 class cown_ptr : cown_ptr_base
 {
 private:
-  /**
-   * Internal Verona runtime cown for this type.
-   */
-  class ActualCown : public VCown<ActualCown>
-  {
-  private:
-    T value;
-
-  public:
-    template<typename... Args>
-    ActualCown(Args&&... ts) : value(std::forward<Args>(ts)...)
-    {}
-
-    template<typename TT>
-    friend class acquired_cown;
-  };
+  using Actual = ActualCown<std::remove_const_t<T>>;
 
   /**
    * Internal Verona runtime cown for this type.
    */
-  ActualCown* allocated_cown = nullptr;
+  Actual* allocated_cown = nullptr;
 
   /**
    * Accesses the internal Verona runtime cown for this handle.
    */
-  Cown* underlying_cown()
+  verona::rt::Cown* underlying_cown() const
   {
     return allocated_cown;
   }
@@ -74,7 +81,7 @@ private:
    * This is internal, and the `make_cown` below is the public interface,
    * which has better behaviour for implicit template arguments.
    */
-  cown_ptr(ActualCown* cown) : allocated_cown(cown) {}
+  cown_ptr(Actual* cown) : allocated_cown(cown) {}
 
 public:
   /**
@@ -118,6 +125,9 @@ public:
   template<typename TT, typename... Args>
   friend cown_ptr<TT> make_cown(Args&&...);
 
+  template<typename TT>
+  friend cown_ptr<const TT> read(cown_ptr<TT>);
+
   template<typename...>
   friend class When;
 };
@@ -130,8 +140,22 @@ public:
 template<typename T, typename... Args>
 cown_ptr<T> make_cown(Args&&... ts)
 {
-  return cown_ptr<T>(
-    new typename cown_ptr<T>::ActualCown(std::forward<Args>(ts)...));
+  static_assert(!std::is_const_v<T>, "Use read to get a read-only cown_ptr");
+  return cown_ptr<T>(new ActualCown<T>(std::forward<Args>(ts)...));
+}
+
+/**
+ * Returns a handle on the same cown as `cown`, that a `when` only acquires
+ * for reading:
+ *
+ *   when (read(c)) << [](acquired_cown<const T> c) { ... };
+ */
+template<typename T>
+cown_ptr<const T> read(cown_ptr<T> cown)
+{
+  auto* c = cown.allocated_cown;
+  cown.allocated_cown = nullptr;
+  return cown_ptr<const T>(c);
 }
 
 /**
@@ -194,4 +218,4 @@ public:
   acquired_cown(const acquired_cown&) = delete;
   acquired_cown& operator=(const acquired_cown&) = delete;
   /// @}
-};
\ No newline at end of file
+};
\ No newline at end of file
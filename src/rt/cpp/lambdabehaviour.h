@@ -17,6 +17,7 @@ namespace verona::rt
   class LambdaBehaviour : public Behaviour
   {
     friend class Cown;
+    friend class MultiMessage;
 
   private:
     T fn;
@@ -34,8 +35,12 @@ namespace verona::rt
 
     static const Behaviour::Descriptor* desc()
     {
+      // The captures of a lambda cannot be traced, but the leak detector
+      // still traces the closure of each behaviour it scans.
       static constexpr Behaviour::Descriptor desc = {
-        sizeof(LambdaBehaviour<T>), f, NULL};
+        sizeof(LambdaBehaviour<T>),
+        f,
+        Behaviour::Descriptor::empty_behaviour_trace};
 
       return &desc;
     }
@@ -56,6 +61,72 @@ namespace verona::rt
     LambdaBehaviour(T fn_) : Behaviour(desc()), fn(std::move(fn_)) {}
   };
 
+  /// The trace function of a `LambdaTimer` whose function refers to no
+  /// cowns.
+  struct NoTimerTrace
+  {
+    void operator()(ObjectStack&) const {}
+  };
+
+  template<class T, class Tr = NoTimerTrace>
+  class LambdaTimer : public Timer
+  {
+  private:
+    T fn;
+    Tr tracer;
+
+    static void run(Timer* t)
+    {
+      auto self = static_cast<LambdaTimer<T, Tr>*>(t);
+      self->fn();
+      self->~LambdaTimer<T, Tr>();
+      ThreadAlloc::get().dealloc<sizeof(LambdaTimer<T, Tr>)>(self);
+    }
+
+    static void trace(const Timer* t, ObjectStack& st)
+    {
+      static_cast<const LambdaTimer<T, Tr>*>(t)->tracer(st);
+    }
+
+  public:
+    LambdaTimer(uint64_t deadline, T fn_, Tr tracer_)
+    : Timer(
+        deadline,
+        run,
+        std::is_same_v<Tr, NoTimerTrace> ? nullptr : trace),
+      fn(std::move(fn_)),
+      tracer(std::move(tracer_))
+    {}
+  };
+
+  /**
+   * Calls `f` on a scheduler thread once `TimerWheel::now()` has reached
+   * `deadline`, in nanoseconds.  `f` runs outside of any behaviour, so
+   * should only schedule behaviours.  Until then, the timer keeps the
+   * runtime running, see `Scheduler::add_timer`.
+   *
+   * `trace` pushes the cowns that `f` will schedule behaviours on.  The leak
+   * detector scans these while the timer is pending, as `f` may hold the
+   * only references to them.
+   *
+   * Must be called from a scheduler thread.
+   */
+  template<typename T, typename Tr = NoTimerTrace>
+  static void schedule_lambda_at(uint64_t deadline, T f, Tr trace = {})
+  {
+    auto* p = ThreadAlloc::get().alloc<sizeof(LambdaTimer<T, Tr>)>();
+    Scheduler::add_timer(
+      new (p) LambdaTimer<T, Tr>(deadline, std::move(f), std::move(trace)));
+  }
+
+  /// As `schedule_lambda_at`, `delay` nanoseconds from now.
+  template<typename T, typename Tr = NoTimerTrace>
+  static void schedule_lambda_after(uint64_t delay, T f, Tr trace = {})
+  {
+    schedule_lambda_at(
+      TimerWheel::now() + delay, std::move(f), std::move(trace));
+  }
+
   template<TransferOwnership transfer = NoTransfer, typename T>
   static void schedule_lambda(Cown* c, T f)
   {
@@ -69,6 +140,26 @@ namespace verona::rt
       count, cowns, std::forward<T>(f));
   }
 
+  template<TransferOwnership transfer = NoTransfer, size_t Count, typename T>
+  static void schedule_lambda(Cown* (&cowns)[Count], T f)
+  {
+    Cown::schedule<LambdaBehaviour<T>, transfer>(cowns, std::forward<T>(f));
+  }
+
+  template<TransferOwnership transfer = NoTransfer, typename T>
+  static void schedule_lambda(size_t count, Request* requests, T f)
+  {
+    Cown::schedule<LambdaBehaviour<T>, transfer>(
+      count, requests, std::forward<T>(f));
+  }
+
+  template<TransferOwnership transfer = NoTransfer, size_t Count, typename T>
+  static void schedule_lambda(Request (&requests)[Count], T f)
+  {
+    Cown::schedule<LambdaBehaviour<T>, transfer>(
+      requests, std::forward<T>(f));
+  }
+
   template<typename T>
   static void schedule_lambda(T f)
   {
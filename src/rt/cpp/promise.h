@@ -2,10 +2,139 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <optional>
 #include <variant>
+#include <vector>
 
 namespace verona::rt
 {
+  /**
+   * The state of a continuation added with `then_with_timeout`, which is
+   * also its timer.  It is shared by the promise, the timer, and the
+   * `PromiseTimeout` handle.  Whichever of the promise, the timer, and
+   * `cancel` claims it first runs or drops the continuation, and the others
+   * only release their reference.
+   */
+  class PromiseWaiter : public Timer
+  {
+    std::atomic<bool> claimed{false};
+    /// One each for the promise, the timer, and the handle.
+    std::atomic<size_t> rc{3};
+
+  protected:
+    /// Destroys the continuation without running it.
+    void (*drop)(PromiseWaiter*);
+    /// Frees the waiter, once it is no longer referenced.
+    void (*destroy)(PromiseWaiter*);
+
+    PromiseWaiter(
+      uint64_t deadline,
+      void (*timeout)(Timer*),
+      void (*drop)(PromiseWaiter*),
+      void (*destroy)(PromiseWaiter*))
+    : Timer(deadline, timeout), drop(drop), destroy(destroy)
+    {}
+
+  public:
+    /// Returns true for the first caller only, which is then responsible
+    /// for the continuation.
+    bool claim()
+    {
+      return !claimed.exchange(true, std::memory_order_acq_rel);
+    }
+
+    bool is_claimed()
+    {
+      return claimed.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Removes the timer from the timer wheel, so that it no longer keeps the
+     * runtime running, unless it is already firing.  Called once the waiter
+     * has been claimed other than by the timer.
+     */
+    void cancel_timer()
+    {
+      if (Scheduler::cancel_timer(this))
+        release();
+    }
+
+    /// Drops the continuation if it has not been claimed yet.
+    bool cancel()
+    {
+      if (!claim())
+        return false;
+      drop(this);
+      cancel_timer();
+      return true;
+    }
+
+    void release()
+    {
+      if (rc.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        destroy(this);
+    }
+  };
+
+  /**
+   * Handle to a continuation added with `then_with_timeout`, which can be
+   * used to cancel it.  Dropping the handle does not cancel the continuation.
+   */
+  class PromiseTimeout
+  {
+    PromiseWaiter* waiter = nullptr;
+
+  public:
+    PromiseTimeout() = default;
+
+    explicit PromiseTimeout(PromiseWaiter* w) : waiter(w) {}
+
+    PromiseTimeout(const PromiseTimeout&) = delete;
+    PromiseTimeout& operator=(const PromiseTimeout&) = delete;
+
+    PromiseTimeout(PromiseTimeout&& old) : waiter(old.waiter)
+    {
+      old.waiter = nullptr;
+    }
+
+    PromiseTimeout& operator=(PromiseTimeout&& old)
+    {
+      if (waiter != nullptr)
+        waiter->release();
+      waiter = old.waiter;
+      old.waiter = nullptr;
+      return *this;
+    }
+
+    ~PromiseTimeout()
+    {
+      if (waiter != nullptr)
+        waiter->release();
+    }
+
+    /**
+     * Destroys the continuation without running it, unless it has already
+     * run or been scheduled to run.  Returns true if it was cancelled.  The
+     * timer is removed from the timer wheel.
+     *
+     * Must be called from a scheduler thread.
+     */
+    bool cancel()
+    {
+      return (waiter != nullptr) && waiter->cancel();
+    }
+
+    /// Returns true if the continuation has run, been scheduled to run, or
+    /// been cancelled.
+    bool is_done()
+    {
+      return (waiter == nullptr) || waiter->is_claimed();
+    }
+  };
+
   /*
    * This class defines a Promise object on top of the verona runtime.
    * A promise is a cown whose lifetime is controlled by the read and write
@@ -32,6 +161,18 @@ namespace verona::rt
 
       int err_code;
       PromiseErr(int code) : err_code(code) {}
+
+    public:
+      /// The write end-point was dropped without fulfilling the promise.
+      static constexpr int BROKEN = -1;
+      /// The promise was not fulfilled before the deadline of a
+      /// `then_with_timeout`.
+      static constexpr int TIMEOUT = -2;
+
+      int code() const
+      {
+        return err_code;
+      }
     };
 
     /**
@@ -57,6 +198,31 @@ namespace verona::rt
         promise->then(std::forward<F>(fn));
       }
 
+      /**
+       * As `then`, but if the promise has not been fulfilled once `timeout`
+       * has passed, `fn` is run with a `PromiseErr::TIMEOUT` error instead.
+       * `fn` runs at most once.  The returned handle can cancel `fn`, which
+       * frees it and anything it captures straight away.
+       *
+       * This costs a timer and a small allocation, and nothing is added to
+       * `then`.  Must be called from a scheduler thread.
+       */
+      template<
+        typename Rep,
+        typename Period,
+        typename F,
+        typename =
+          std::enable_if_t<std::is_invocable_v<F, std::variant<T, PromiseErr>>>>
+      PromiseTimeout
+      then_with_timeout(std::chrono::duration<Rep, Period> timeout, F&& fn)
+      {
+        return promise->then_with_timeout(
+          (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            timeout)
+            .count(),
+          std::forward<F>(fn));
+      }
+
       PromiseR() : promise(nullptr) {}
 
       PromiseR(Promise* p, TransferOwnership transfer = NoTransfer) : promise(p)
@@ -171,6 +337,122 @@ namespace verona::rt
     T val;
     bool fulfilled;
 
+    /**
+     * The state shared by the continuations of `when_all`.  It is allocated
+     * in one block, followed by a slot for each value and then a flag for
+     * each slot recording whether it holds a value.  Each continuation only
+     * writes its own slot and flag, and they are only read by the last one to
+     * decrement `count`.
+     */
+    class AllJoin
+    {
+      size_t n;
+
+    public:
+      std::atomic<size_t> count;
+      std::atomic<bool> failed{false};
+      typename Promise<std::vector<T>>::PromiseW result;
+
+    private:
+      AllJoin(size_t n, typename Promise<std::vector<T>>::PromiseW&& w)
+      : n(n), count(n), result(std::move(w))
+      {}
+
+      static constexpr size_t slots_offset()
+      {
+        return bits::align_up(sizeof(AllJoin), alignof(T));
+      }
+
+      static size_t size(size_t n)
+      {
+        return slots_offset() + (n * sizeof(T)) + (n * sizeof(bool));
+      }
+
+      T* slots()
+      {
+        return reinterpret_cast<T*>(
+          reinterpret_cast<std::byte*>(this) + slots_offset());
+      }
+
+      bool* filled()
+      {
+        return reinterpret_cast<bool*>(slots() + n);
+      }
+
+    public:
+      static AllJoin*
+      create(size_t n, typename Promise<std::vector<T>>::PromiseW&& w)
+      {
+        void* p = ThreadAlloc::get().alloc(size(n));
+        auto* join = new (p) AllJoin(n, std::move(w));
+        std::fill_n(join->filled(), n, false);
+        return join;
+      }
+
+      /// Stores the value of the `i`th promise.
+      void set(size_t i, T&& v)
+      {
+        new (&slots()[i]) T(std::move(v));
+        filled()[i] = true;
+      }
+
+      /**
+       * Fulfills the result with the values, unless a promise was broken,
+       * and frees the join.  Called by the last continuation.
+       */
+      void complete()
+      {
+        if (!failed.load(std::memory_order_acquire))
+        {
+          std::vector<T> values;
+          values.reserve(n);
+          for (size_t i = 0; i < n; i++)
+            values.push_back(std::move(slots()[i]));
+          Promise<std::vector<T>>::fulfill(
+            std::move(result), std::move(values));
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+          if (filled()[i])
+            slots()[i].~T();
+        }
+
+        size_t sz = size(n);
+        this->~AllJoin();
+        ThreadAlloc::get().dealloc(this, sz);
+      }
+    };
+
+    /// The state shared by the continuations of `when_any`.
+    class AnyJoin
+    {
+    public:
+      std::atomic<size_t> count;
+      std::atomic<bool> won{false};
+      typename Promise<std::pair<size_t, T>>::PromiseW result;
+
+    private:
+      AnyJoin(size_t n, typename Promise<std::pair<size_t, T>>::PromiseW&& w)
+      : count(n), result(std::move(w))
+      {}
+
+    public:
+      static AnyJoin*
+      create(size_t n, typename Promise<std::pair<size_t, T>>::PromiseW&& w)
+      {
+        void* p = ThreadAlloc::get().alloc<sizeof(AnyJoin)>();
+        return new (p) AnyJoin(n, std::move(w));
+      }
+
+      /// Frees the join.  Called by the last continuation.
+      void complete()
+      {
+        this->~AnyJoin();
+        ThreadAlloc::get().dealloc<sizeof(AnyJoin)>(this);
+      }
+    };
+
     template<
       typename F,
       typename =
@@ -190,8 +472,79 @@ namespace verona::rt
           }
         }
         else
-          fn(PromiseErr(-1));
+          fn(PromiseErr(PromiseErr::BROKEN));
+      });
+    }
+
+    template<typename F>
+    class Waiter : public PromiseWaiter
+    {
+      static void drop_fn(PromiseWaiter* w)
+      {
+        static_cast<Waiter*>(w)->fn.reset();
+      }
+
+      static void destroy_waiter(PromiseWaiter* w)
+      {
+        auto* waiter = static_cast<Waiter*>(w);
+        waiter->~Waiter();
+        ThreadAlloc::get().dealloc<sizeof(Waiter)>(waiter);
+      }
+
+      static void timeout(Timer* t)
+      {
+        auto* w = static_cast<Waiter*>(t);
+        if (w->claim())
+        {
+          schedule_lambda([w]() {
+            w->run(PromiseErr(PromiseErr::TIMEOUT));
+            w->release();
+          });
+        }
+        else
+        {
+          w->release();
+        }
+      }
+
+    public:
+      std::optional<F> fn;
+
+      Waiter(uint64_t deadline, F f)
+      : PromiseWaiter(deadline, timeout, drop_fn, destroy_waiter),
+        fn(std::move(f))
+      {}
+
+      /// Runs and destroys the continuation.  Only called once claimed.
+      void run(std::variant<T, PromiseErr> v)
+      {
+        (*fn)(std::move(v));
+        fn.reset();
+      }
+    };
+
+    template<typename F>
+    PromiseTimeout then_with_timeout(uint64_t timeout, F&& fn)
+    {
+      using W = Waiter<std::decay_t<F>>;
+      void* p = ThreadAlloc::get().alloc<sizeof(W)>();
+      auto* w = new (p) W(TimerWheel::now() + timeout, std::forward<F>(fn));
+
+      // Added first, so that the promise can remove it once claimed.
+      Scheduler::add_timer(w);
+
+      // Once the timer has claimed the waiter, the promise only releases its
+      // reference when it is fulfilled or broken.
+      then([w](std::variant<T, PromiseErr> v) {
+        if (w->claim())
+        {
+          w->cancel_timer();
+          w->run(std::move(v));
+        }
+        w->release();
       });
+
+      return PromiseTimeout(w);
     }
 
     /**
@@ -221,6 +574,79 @@ namespace verona::rt
       return std::make_pair(std::move(r), std::move(w));
     }
 
+    /**
+     * Returns a promise of the values of all of `promises`, in order.  If any
+     * of them is broken, the returned promise is broken as soon as that is
+     * seen.
+     *
+     * The results are joined by a single countdown and result buffer shared
+     * by one continuation on each promise, rather than by a cown.
+     *
+     * Returns a `Promise<std::vector<T>>::PromiseR`.  The return type is
+     * deduced so that it is only instantiated when used.
+     */
+    static auto when_all(std::vector<PromiseR>& promises)
+    {
+      auto pp = Promise<std::vector<T>>::create_promise();
+      if (promises.empty())
+      {
+        Promise<std::vector<T>>::fulfill(std::move(pp.second), {});
+        return std::move(pp.first);
+      }
+
+      auto* join = AllJoin::create(promises.size(), std::move(pp.second));
+      for (size_t i = 0; i < promises.size(); i++)
+      {
+        promises[i].then([join, i](std::variant<T, PromiseErr> v) {
+          if (std::holds_alternative<T>(v))
+          {
+            join->set(i, std::get<T>(std::move(v)));
+          }
+          else if (!join->failed.exchange(true, std::memory_order_acq_rel))
+          {
+            // Dropping the write end-point breaks the promise.
+            auto broken = std::move(join->result);
+          }
+
+          if (join->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            join->complete();
+        });
+      }
+      return std::move(pp.first);
+    }
+
+    /**
+     * Returns a promise of the index and value of the first of `promises` to
+     * be fulfilled.  The returned promise is only broken if all of them are.
+     *
+     * Returns a `Promise<std::pair<size_t, T>>::PromiseR`.
+     */
+    static auto when_any(std::vector<PromiseR>& promises)
+    {
+      auto pp = Promise<std::pair<size_t, T>>::create_promise();
+      if (promises.empty())
+        return std::move(pp.first);
+
+      auto* join = AnyJoin::create(promises.size(), std::move(pp.second));
+      for (size_t i = 0; i < promises.size(); i++)
+      {
+        promises[i].then([join, i](std::variant<T, PromiseErr> v) {
+          if (
+            std::holds_alternative<T>(v) &&
+            !join->won.exchange(true, std::memory_order_acq_rel))
+          {
+            Promise<std::pair<size_t, T>>::fulfill(
+              std::move(join->result),
+              std::make_pair(i, std::get<T>(std::move(v))));
+          }
+
+          if (join->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            join->complete();
+        });
+      }
+      return std::move(pp.first);
+    }
+
     /**
      * Fulfill the promise with a value and put the promise cown in a
      * scheduler thread queue. A PromiseW can be fulfilled only once.
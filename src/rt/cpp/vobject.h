@@ -35,6 +35,21 @@ namespace verona::rt
   struct has_finaliser<T, std::void_t<decltype(&T::finaliser)>> : std::true_type
   {};
 
+  template<class T, class = void>
+  struct has_batch_limit : std::false_type
+  {};
+  template<class T>
+  struct has_batch_limit<T, std::void_t<decltype(&T::batch_limit)>>
+  : std::true_type
+  {};
+
+  template<class T, class = void>
+  struct has_relocate : std::false_type
+  {};
+  template<class T>
+  struct has_relocate<T, std::void_t<decltype(&T::relocate)>> : std::true_type
+  {};
+
   template<class T>
   struct has_destructor
   {
@@ -81,6 +96,17 @@ namespace verona::rt
       ((T*)o)->~T();
     }
 
+    static void gc_relocate(Object* o, ObjectRelocator& r)
+    {
+      if constexpr (has_relocate<T>::value)
+        ((T*)o)->relocate(r);
+      else
+      {
+        UNUSED(o);
+        UNUSED(r);
+      }
+    }
+
     void trace(ObjectStack&) {}
 
   public:
@@ -93,7 +119,8 @@ namespace verona::rt
                                 has_finaliser<T>::value ? gc_final : nullptr,
                                 has_notified<T>::value ? gc_notified : nullptr,
                                 has_destructor<T>::value ? gc_destructor :
-                                                           nullptr};
+                                                           nullptr,
+                                has_relocate<T>::value ? gc_relocate : nullptr};
 
       return &desc;
     }
@@ -140,6 +167,13 @@ namespace verona::rt
       // region.
     }
 
+    void operator delete(void*, RegionType, size_t)
+    {
+      // Should not be called directly, present to allow calling if the
+      // constructor throws an exception. The object lifetime is managed by the
+      // region.
+    }
+
     void* operator new[](size_t size) = delete;
     void operator delete[](void* p) = delete;
     void operator delete[](void* p, size_t sz) = delete;
@@ -165,18 +199,32 @@ namespace verona::rt
     {
       return api::create_fresh_region<V>(rt, V::desc());
     }
+
+    /// Creates a region expected to hold `size_hint` bytes of objects, see
+    /// `api::create_fresh_region`.
+    void* operator new(size_t, RegionType rt, size_t size_hint)
+    {
+      return api::create_fresh_region<V>(rt, V::desc(), size_hint);
+    }
   };
 
   /**
    * Converts a C++ class into a Verona Cown
    *
    * Will fill the Verona descriptor with relevant fields.
+   *
+   * If the class has a static `batch_limit` method, returning a `BatchLimit`,
+   * this is used as the batch limit for all cowns of the class.
    */
   template<class T>
   class VCown : public VBase<T, Cown>
   {
   public:
-    VCown() : VBase<T, Cown>() {}
+    VCown() : VBase<T, Cown>()
+    {
+      if constexpr (has_batch_limit<T>::value)
+        this->set_batch_limit(T::batch_limit());
+    }
 
     void* operator new(size_t)
     {
@@ -3,6 +3,7 @@
 
 #include "cown.h"
 
+#include <chrono>
 #include <functional>
 #include <tuple>
 #include <utility>
@@ -28,6 +29,12 @@ class When
   template<typename... Args2>
   friend When<Args2...> when(Args2... args);
 
+  template<typename...>
+  friend class WhenAfter;
+
+  template<typename...>
+  friend class WhenEvery;
+
   /**
    * Internally uses AcquiredCown.  The cown is only acquired after the
    * behaviour is scheduled.
@@ -35,25 +42,62 @@ class When
   std::tuple<Args...> cown_tuple;
 
   /**
-   * This uses template programming to turn the std::tuple into a C style
-   * stack allocated array.
-   * The index template parameter is used to perform each the assignment for
-   * each index.
+   * Converts a single `cown_ptr` into a request to acquire its cown, which
+   * is read-only for a `cown_ptr<const T>`.
    */
-  template<size_t index = 0>
-  void array_assign(Cown** array)
+  template<typename C>
+  static verona::rt::Request cown_ptr_to_request(cown_ptr<C>& c)
   {
-    if constexpr (index >= sizeof...(Args))
-    {
-      return;
-    }
+    auto* cown = c.underlying_cown();
+    assert(cown != nullptr);
+    if constexpr (std::is_const_v<C>)
+      return verona::rt::Request::read(cown);
     else
-    {
-      auto p = std::get<index>(cown_tuple);
-      array[index] = p.underlying_cown();
-      assert(array[index] != nullptr);
-      array_assign<index + 1>(array);
-    }
+      return verona::rt::Request::write(cown);
+  }
+
+  /**
+   * Pushes the cowns in `cowns` onto `st`.  The leak detector scans these
+   * while a timer that will schedule a behaviour on them is pending.
+   */
+  static void
+  trace_cowns(const std::tuple<Args...>& cowns, verona::rt::ObjectStack& st)
+  {
+    std::apply(
+      [&st](const Args&... args) { (st.push(args.underlying_cown()), ...); },
+      cowns);
+  }
+
+  /**
+   * This uses template programming to turn the std::tuple into a C style
+   * stack allocated array of requests, and schedules the behaviour on them.
+   */
+  template<typename F, size_t... Is>
+  void schedule(F&& f, std::index_sequence<Is...>)
+  {
+    verona::rt::Request requests[] = {
+      cown_ptr_to_request(std::get<Is>(cown_tuple))...};
+
+    verona::rt::schedule_lambda(
+      requests,
+      [f = std::forward<F>(f), cown_tuple = cown_tuple]() mutable {
+        apply_acquired(f, cown_tuple);
+      });
+  }
+
+  /**
+   * Calls `f` with the cowns in `cowns` as `acquired_cown`s, and returns its
+   * result.  Must be called from the behaviour that acquired them.
+   */
+  template<typename F>
+  static decltype(auto) apply_acquired(F& f, std::tuple<Args...>& cowns)
+  {
+    /// Effectively converts cown_ptr... to acquired_cown... .
+    auto lift_f = [&f](Args... args) mutable {
+      return f(cown_ptr_to_acquired(args)...);
+    };
+
+    return std::apply(lift_f, cowns);
   }
 
   template<typename... Ts>
@@ -88,20 +132,7 @@ public:
     }
     else
     {
-      verona::rt::Cown* cowns[sizeof...(Args)];
-      array_assign(cowns);
-
-      verona::rt::schedule_lambda(
-        sizeof...(Args),
-        cowns,
-        [f = std::forward<F>(f), cown_tuple = cown_tuple]() mutable {
-          /// Effectively converts cown_ptr... to acquired_cown... .
-          auto lift_f = [f = std::forward<F>(f)](Args... args) mutable {
-            f(cown_ptr_to_acquired(args)...);
-          };
-
-          std::apply(lift_f, cown_tuple);
-        });
+      schedule(std::forward<F>(f), std::index_sequence_for<Args...>{});
     }
   }
 };
@@ -115,4 +146,168 @@ template<typename... Args>
 When<Args...> when(Args... args)
 {
   return When<Args...>(args...);
-}
\ No newline at end of file
+}
+
+/**
+ * Class for staging the creation of a `when` that is delayed.
+ *
+ * Do not call directly use `when_after`.
+ */
+template<typename... Args>
+class WhenAfter
+{
+  template<typename Rep, typename Period, typename... Args2>
+  friend WhenAfter<Args2...>
+  when_after(std::chrono::duration<Rep, Period> delay, Args2... args);
+
+  /// Nanoseconds to wait before scheduling the behaviour.
+  uint64_t delay;
+
+  std::tuple<Args...> cown_tuple;
+
+  WhenAfter(uint64_t delay, Args... args) : delay(delay), cown_tuple(args...)
+  {
+    static_assert(
+      std::conjunction_v<std::is_base_of<cown_ptr_base, Args>...>,
+      "Not a cown_ptr");
+  }
+
+public:
+  /**
+   * Applies the closure to schedule the behaviour on the set of cowns once
+   * the delay has passed.
+   */
+  template<typename F>
+  void operator<<(F&& f)
+  {
+    verona::rt::schedule_lambda_after(
+      delay, [f = std::forward<F>(f), cown_tuple = cown_tuple]() mutable {
+        std::apply(
+          [&f](Args... args) { when(args...) << std::move(f); }, cown_tuple);
+      },
+      [cown_tuple = cown_tuple](verona::rt::ObjectStack& st) {
+        When<Args...>::trace_cowns(cown_tuple, st);
+      });
+  }
+};
+
+/**
+ * Class for staging the creation of a periodic `when`.
+ *
+ * Do not call directly use `when_every`.
+ */
+template<typename... Args>
+class WhenEvery
+{
+  template<typename Rep, typename Period, typename... Args2>
+  friend WhenEvery<Args2...>
+  when_every(std::chrono::duration<Rep, Period> period, Args2... args);
+
+  /// Nanoseconds between the behaviours.
+  uint64_t period;
+
+  std::tuple<Args...> cown_tuple;
+
+  WhenEvery(uint64_t period, Args... args) : period(period), cown_tuple(args...)
+  {
+    static_assert(
+      std::conjunction_v<std::is_base_of<cown_ptr_base, Args>...>,
+      "Not a cown_ptr");
+  }
+
+  /**
+   * Schedules `f` on `cowns` once `deadline` has passed, and again each
+   * `period` after that for as long as it returns true.  Periods that have
+   * already passed by the time `f` returns are skipped.
+   */
+  template<typename F>
+  static void schedule_every(
+    uint64_t deadline, uint64_t period, std::tuple<Args...> cowns, F f)
+  {
+    auto tick = [deadline, period, cowns, f = std::move(f)]() mutable {
+      bool again;
+      if constexpr (sizeof...(Args) == 0)
+        again = f();
+      else
+        again = When<Args...>::apply_acquired(f, cowns);
+      if (!again)
+        return;
+
+      uint64_t next = deadline + period;
+      uint64_t now = verona::rt::TimerWheel::now();
+      if (next < now)
+        next += ((now - next) / period + 1) * period;
+      schedule_every(next, period, cowns, std::move(f));
+    };
+
+    verona::rt::schedule_lambda_at(
+      deadline, [cowns, tick = std::move(tick)]() mutable {
+        if constexpr (sizeof...(Args) == 0)
+        {
+          tick();
+        }
+        else
+        {
+          std::apply(
+            [&tick](Args... args) {
+              verona::rt::Request requests[] = {
+                When<Args...>::cown_ptr_to_request(args)...};
+              verona::rt::schedule_lambda(requests, std::move(tick));
+            },
+            cowns);
+        }
+      },
+      [cowns](verona::rt::ObjectStack& st) {
+        When<Args...>::trace_cowns(cowns, st);
+      });
+  }
+
+public:
+  /**
+   * Applies the closure to schedule the behaviour on the set of cowns each
+   * period, starting one period from now.  The closure returns false to
+   * stop.
+   */
+  template<typename F>
+  void operator<<(F&& f)
+  {
+    schedule_every(
+      verona::rt::TimerWheel::now() + period,
+      period,
+      cown_tuple,
+      std::forward<F>(f));
+  }
+};
+
+/**
+ * Implements a `when` whose behaviour is scheduled once `delay` has passed.
+ * The cowns are only requested then, so are not held while waiting.
+ *
+ *   when_after(10ms, cown1, ..., cownn) << closure;
+ *
+ * Must be called from a scheduler thread.
+ */
+template<typename Rep, typename Period, typename... Args>
+WhenAfter<Args...>
+when_after(std::chrono::duration<Rep, Period> delay, Args... args)
+{
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(delay);
+  return WhenAfter<Args...>((uint64_t)ns.count(), args...);
+}
+
+/**
+ * Implements a periodic `when`, whose behaviour is scheduled each `period`
+ * for as long as the closure returns true.
+ *
+ *   when_every(10ms, cown1, ..., cownn) << [](auto...) { return more; };
+ *
+ * Must be called from a scheduler thread.
+ */
+template<typename Rep, typename Period, typename... Args>
+WhenEvery<Args...>
+when_every(std::chrono::duration<Rep, Period> period, Args... args)
+{
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(period);
+  assert(ns.count() > 0);
+  return WhenEvery<Args...>((uint64_t)ns.count(), args...);
+}
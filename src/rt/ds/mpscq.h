@@ -141,6 +141,21 @@ namespace verona::rt
      * Returns true if the queue was sleeping when the message was added.
      **/
     bool enqueue(T* t)
+    {
+      return enqueue(t, [](T*) {});
+    }
+
+    /**
+     * Enqueues (inserts) a message into the queue, calling `before_link`
+     * with the previous back of the queue once the message has taken its
+     * place in the queue, but before it is linked to the previous message.
+     * Until then, the message cannot be dequeued, and the previous message
+     * cannot be deallocated.
+     *
+     * Returns true if the queue was sleeping when the message was added.
+     **/
+    template<typename F>
+    bool enqueue(T* t, F&& before_link)
     {
       assert(is_clear(t));
 
@@ -161,6 +176,8 @@ namespace verona::rt
       was_sleeping = has_state(prev, SLEEPING);
       prev = clear_state(prev);
 
+      before_link(prev);
+
       prev->next.store(t, std::memory_order_relaxed);
       return was_sleeping;
     }
@@ -172,8 +189,8 @@ namespace verona::rt
      *
      * If it returns a message, will delete the previous message.
      *
-     * Messages are deallocated after the next message is dequeued. This ensures
-     * that there is always a message in the queue.
+     * Messages are deallocated, with `T::dealloc`, after the next message is
+     * dequeued. This ensures that there is always a message in the queue.
      **/
     T* dequeue(snmalloc::Alloc& alloc, bool& notify)
     {
@@ -194,7 +211,7 @@ namespace verona::rt
       assert(front);
       std::atomic_thread_fence(std::memory_order_acquire);
 
-      alloc.dealloc(fnt, fnt->size());
+      fnt->dealloc(alloc);
       invariant();
 
       if (has_state(next, NOTIFY))
@@ -78,6 +78,7 @@ namespace verona::rt
   using Alloc = snmalloc::Alloc;
   using namespace snmalloc;
   class Object;
+  class ObjectRelocator;
   class RegionBase;
 
   using RefCounts = Bag<Object, uintptr_t, Alloc>;
@@ -114,11 +115,20 @@ namespace verona::rt
 
     using DestructorFunction = void (*)(Object* o);
 
+    // for field in o do
+    //  r.update(o.field)
+    //
+    // Only objects with a relocate function are moved when a trace region is
+    // compacted.  Such an object must remain valid when copied to a new
+    // address with memcpy, without running its destructor on the old copy.
+    using RelocateFunction = void (*)(Object* o, ObjectRelocator& r);
+
     size_t size;
     TraceFunction trace;
     FinalFunction finaliser;
     NotifiedFunction notified = nullptr;
     DestructorFunction destructor = nullptr;
+    RelocateFunction relocate = nullptr;
     // TODO: virtual dispatch, pattern matching on type, reflection
   };
 
@@ -446,6 +456,8 @@ namespace verona::rt
     friend size_t debug_get_ref_count(Object* o);
 
     friend class LinkedObjectStack;
+    friend class ObjectPool;
+    friend class ObjectRelocator;
 
     template<typename T>
     friend class Noticeboard;
@@ -894,6 +906,33 @@ namespace verona::rt
       return is_trivial(get_descriptor());
     }
 
+    inline bool has_relocate()
+    {
+      return get_descriptor()->relocate != nullptr;
+    }
+
+    inline void relocate(ObjectRelocator& r)
+    {
+      get_descriptor()->relocate(this, r);
+    }
+
+    /**
+     * Records that this object has been copied to `to`, while its region is
+     * compacted.  Until the old copy is deallocated, `forwarded` maps it to
+     * `to`.
+     */
+    inline void set_forward(Object* to)
+    {
+      init_next(to);
+      mark();
+    }
+
+    /// Returns where `o` has been moved to, or `o` if it has not moved.
+    static Object* forwarded(Object* o)
+    {
+      return (o->get_class() == RegionMD::MARKED) ? o->get_next_any_mark() : o;
+    }
+
   public:
     inline bool cown_zero_rc()
     {
@@ -953,6 +992,23 @@ namespace verona::rt
     }
   };
 
+  /**
+   * Passed to the relocate function of each object, while the trace region
+   * it is in is compacted.  See `Descriptor::RelocateFunction`.
+   */
+  class ObjectRelocator
+  {
+  public:
+    /// Points `field` at the new address of the object it refers to, if that
+    /// object has been moved.
+    template<typename T>
+    void update(T*& field)
+    {
+      if (field != nullptr)
+        field = static_cast<T*>(Object::forwarded(field));
+    }
+  };
+
   /// Returns the size required for a Verona object to embed the
   /// C++ object T.
   template<class T>
@@ -45,6 +45,11 @@ namespace verona::rt
       size_t group;
       size_t id;
       bool hyperthread;
+      // Identifies the physical core, shared by all hardware threads of
+      // that core.
+      size_t core;
+      // Identifies the last level cache shared by this CPU.
+      size_t llc;
 
       size_t get()
       {
@@ -100,12 +105,11 @@ namespace verona::rt
       uint32_t index = 0;
       uint32_t found = 0;
 
-      // TODO: CPU topology detection for Linux
       while (found < count)
       {
         if (CPU_ISSET(index, &all_cpus))
         {
-          cpus.push_back(CPU{0, 0, 0, index, false});
+          cpus.push_back(CPU{0, 0, 0, index, false, index, 0});
           found++;
         }
 
@@ -149,12 +153,17 @@ namespace verona::rt
 
             if (idmask & p->Processor.GroupMask[j].Mask)
             {
+              size_t cpu_package =
+                get_package(group, id, package, package_count);
+
               top->cpus.push_back(
                 CPU{get_numa_node(group, id, numa, numa_count),
-                    get_package(group, id, package, package_count),
+                    cpu_package,
                     group,
                     id,
-                    hyperthread});
+                    hyperthread,
+                    i,
+                    cpu_package});
 
               hyperthread = true;
             }
@@ -171,6 +180,7 @@ namespace verona::rt
       top->get_cpuset<cpu_set_t>([](cpu_set_t& all_cpus) {
         sched_getaffinity(0, sizeof(cpu_set_t), &all_cpus);
       });
+      top->read_sysfs_topology();
 #elif defined(FreeBSD_KERNEL)
       top->get_cpuset<cpuset_t>(
         [](cpuset_t& all_cpus) { CPU_COPY(cpuset_root, &all_cpus); });
@@ -193,7 +203,7 @@ namespace verona::rt
         top->cpus.reserve(core_count);
         for (uint32_t index = 0; index < core_count; index++)
         {
-          top->cpus.push_back(CPU{0, 0, 0, index, false});
+          top->cpus.push_back(CPU{0, 0, 0, index, false, index, 0});
         }
       }
 #else
@@ -220,7 +230,173 @@ namespace verona::rt
       return cpus.size();
     }
 
+    /**
+     * Returns how far apart the CPUs at two indices are, where the indices
+     * are the same as those passed to `get`:
+     *  - 0: the same physical core.
+     *  - 1: the same last level cache.
+     *  - 2: the same NUMA node.
+     *  - 3: the same package.
+     *  - 4: anywhere else.
+     */
+    size_t distance(size_t index1, size_t index2)
+    {
+      if (cpus.size() == 0)
+        abort();
+
+      auto& a = cpus.at(index1 % cpus.size());
+      auto& b = cpus.at(index2 % cpus.size());
+
+      if ((a.group == b.group) && (a.core == b.core))
+        return 0;
+
+      if ((a.package == b.package) && (a.llc == b.llc))
+        return 1;
+
+      if (a.numa_node == b.numa_node)
+        return 2;
+
+      if (a.package == b.package)
+        return 3;
+
+      return 4;
+    }
+
   private:
+#if defined(__linux__)
+    /**
+     * Fill in the NUMA node, package, physical core and last level cache of
+     * each CPU from sysfs.  Any information that cannot be read is left at
+     * the defaults from `get_cpuset`, so this degrades to a flat topology
+     * inside containers that do not expose sysfs.
+     */
+    void read_sysfs_topology()
+    {
+      char path[128];
+
+      for (auto& cpu : cpus)
+      {
+        snprintf(
+          path,
+          sizeof(path),
+          "/sys/devices/system/cpu/cpu%zu/topology/physical_package_id",
+          cpu.id);
+        read_sysfs_value(path, cpu.package);
+
+        // The first hardware thread listed for a core is treated as the
+        // physical core, and the others as its hyperthreads.
+        snprintf(
+          path,
+          sizeof(path),
+          "/sys/devices/system/cpu/cpu%zu/topology/thread_siblings_list",
+          cpu.id);
+        size_t first_sibling = cpu.id;
+        if (read_sysfs_value(path, first_sibling))
+        {
+          cpu.core = first_sibling;
+          cpu.hyperthread = first_sibling != cpu.id;
+        }
+
+        // The highest level cache listed is the last level cache. It is
+        // identified by the first CPU sharing it.
+        size_t max_level = 0;
+        for (size_t index = 0;; index++)
+        {
+          size_t level;
+          snprintf(
+            path,
+            sizeof(path),
+            "/sys/devices/system/cpu/cpu%zu/cache/index%zu/level",
+            cpu.id,
+            index);
+          if (!read_sysfs_value(path, level))
+            break;
+
+          if (level < max_level)
+            continue;
+
+          snprintf(
+            path,
+            sizeof(path),
+            "/sys/devices/system/cpu/cpu%zu/cache/index%zu/shared_cpu_list",
+            cpu.id,
+            index);
+          if (read_sysfs_value(path, cpu.llc))
+            max_level = level;
+        }
+      }
+
+      // Each NUMA node lists the CPUs it contains.  Node numbers may be
+      // sparse, so missing node directories are skipped.
+      size_t node_count = 0;
+      read_sysfs_list(
+        "/sys/devices/system/node/online",
+        [&node_count](size_t node) { node_count = node + 1; });
+
+      for (size_t node = 0; node < node_count; node++)
+      {
+        snprintf(
+          path, sizeof(path), "/sys/devices/system/node/node%zu/cpulist", node);
+        read_sysfs_list(path, [this, node](size_t id) {
+          for (auto& cpu : cpus)
+          {
+            if (cpu.id == id)
+              cpu.numa_node = node;
+          }
+        });
+      }
+    }
+
+    /**
+     * Read a single leading decimal value from a sysfs file.  For a list
+     * file, such as `thread_siblings_list`, this is the first entry.
+     */
+    static bool read_sysfs_value(const char* path, size_t& result)
+    {
+      FILE* f = fopen(path, "r");
+      if (f == nullptr)
+        return false;
+
+      bool success = fscanf(f, "%zu", &result) == 1;
+      fclose(f);
+      return success;
+    }
+
+    /**
+     * Apply `apply` to every entry in a sysfs list file, which has the
+     * format "0-3,8,10-11".
+     */
+    template<typename F>
+    static void read_sysfs_list(const char* path, F apply)
+    {
+      FILE* f = fopen(path, "r");
+      if (f == nullptr)
+        return;
+
+      size_t first;
+      while (fscanf(f, "%zu", &first) == 1)
+      {
+        size_t last = first;
+        int c = fgetc(f);
+
+        if (c == '-')
+        {
+          if (fscanf(f, "%zu", &last) != 1)
+            break;
+          c = fgetc(f);
+        }
+
+        for (size_t i = first; i <= last; i++)
+          apply(i);
+
+        if (c != ',')
+          break;
+      }
+
+      fclose(f);
+    }
+#endif
+
 #ifdef _WIN32
     static PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX
     get_info(LOGICAL_PROCESSOR_RELATIONSHIP relation, size_t& count)
@@ -0,0 +1,191 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+/**
+ * This file provides a mechanism for waiting on the readiness of file
+ * descriptors.
+ *
+ * Readiness is edge triggered: a descriptor is reported once when it becomes
+ * ready, and is not reported again until it has been read or written until
+ * it would block.  A thread waiting in `wait` can be woken by `wake`.
+ *
+ * On platforms without an implementation, `supported` is false, and no
+ * descriptor can be added.
+ */
+#if defined(__linux__)
+#  include <cerrno>
+#  include <cstdint>
+#  include <sys/epoll.h>
+#  include <sys/eventfd.h>
+#  include <unistd.h>
+
+namespace verona::rt::pal
+{
+  class Poller
+  {
+    /// Maximum number of events handled by one call to `wait`.
+    static constexpr int MAX_EVENTS = 64;
+
+    int epoll_fd = -1;
+    /// Written to by `wake`.  Registered with no data.
+    int wake_fd = -1;
+
+  public:
+    static constexpr bool supported = true;
+
+    enum Interest : uint32_t
+    {
+      Read = 1,
+      Write = 2
+    };
+
+    constexpr Poller() = default;
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    bool is_open() const
+    {
+      return epoll_fd != -1;
+    }
+
+    bool open()
+    {
+      epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+      if (epoll_fd == -1)
+        return false;
+
+      wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      epoll_event ev{};
+      ev.events = EPOLLIN | EPOLLET;
+      ev.data.ptr = nullptr;
+      if (
+        (wake_fd == -1) ||
+        (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) != 0))
+      {
+        close();
+        return false;
+      }
+      return true;
+    }
+
+    void close()
+    {
+      if (wake_fd != -1)
+        ::close(wake_fd);
+      if (epoll_fd != -1)
+        ::close(epoll_fd);
+      wake_fd = -1;
+      epoll_fd = -1;
+    }
+
+    /// Starts watching `fd` for the `Interest`s in `interest`.  `data` is
+    /// passed back by `wait` when it is ready, and must not be null.
+    bool add(int fd, uint32_t interest, void* data)
+    {
+      epoll_event ev{};
+      ev.events = EPOLLET | EPOLLRDHUP;
+      if (interest & Read)
+        ev.events |= EPOLLIN;
+      if (interest & Write)
+        ev.events |= EPOLLOUT;
+      ev.data.ptr = data;
+      return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+    }
+
+    bool remove(int fd)
+    {
+      return epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr) == 0;
+    }
+
+    /**
+     * Waits for up to `timeout_ms` milliseconds, or forever if it is -1, for
+     * a watched descriptor to be ready or for a call to `wake`.  Calls `f`
+     * with the data of each ready descriptor, and returns the number of
+     * these.
+     */
+    template<typename F>
+    size_t wait(int timeout_ms, F&& f)
+    {
+      epoll_event events[MAX_EVENTS];
+      int n = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout_ms);
+      if (n < 0)
+        return 0;
+
+      size_t ready = 0;
+      for (int i = 0; i < n; i++)
+      {
+        if (events[i].data.ptr == nullptr)
+        {
+          uint64_t count;
+          while (::read(wake_fd, &count, sizeof(count)) > 0)
+          {}
+          continue;
+        }
+
+        f(events[i].data.ptr);
+        ready++;
+      }
+      return ready;
+    }
+
+    void wake()
+    {
+      uint64_t one = 1;
+      while ((::write(wake_fd, &one, sizeof(one)) < 0) && (errno == EINTR))
+      {}
+    }
+  };
+} // namespace verona::rt::pal
+#else
+#  include <cstddef>
+#  include <cstdint>
+
+namespace verona::rt::pal
+{
+  class Poller
+  {
+  public:
+    static constexpr bool supported = false;
+
+    enum Interest : uint32_t
+    {
+      Read = 1,
+      Write = 2
+    };
+
+    constexpr Poller() = default;
+
+    bool is_open() const
+    {
+      return false;
+    }
+
+    bool open()
+    {
+      return false;
+    }
+
+    void close() {}
+
+    bool add(int, uint32_t, void*)
+    {
+      return false;
+    }
+
+    bool remove(int)
+    {
+      return false;
+    }
+
+    template<typename F>
+    size_t wait(int, F&&)
+    {
+      return 0;
+    }
+
+    void wake() {}
+  };
+} // namespace verona::rt::pal
+#endif
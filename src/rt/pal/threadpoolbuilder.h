@@ -46,6 +46,24 @@ namespace verona::rt
       this->thread_count = thread_count - 1;
     }
 
+    /**
+     * Returns the topological distance between the CPUs that the threads
+     * added at positions `index1` and `index2` are pinned to.  Smaller is
+     * closer.  See `Topology::distance`.
+     */
+    static size_t distance(size_t index1, size_t index2)
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      // Threads are not pinned with systematic testing, so treat all threads
+      // as equally distant.
+      UNUSED(index1);
+      UNUSED(index2);
+      return 0;
+#else
+      return topology.get().distance(index1, index2);
+#endif
+    }
+
     /**
      * Add a thread to run in this thread pool.
      */
@@ -146,6 +146,20 @@ namespace verona::rt
       UNUSED(unique);
     }
 
+    /// Moves the entry for `from` to `to`, which is a copy of `from` made
+    /// while compacting the region.
+    void move(Alloc& alloc, Object* from, Object* to)
+    {
+      auto it = external_map->find(from);
+      assert(it != external_map->end());
+      auto* ext_ref = it.value();
+      external_map->erase(it);
+
+      if (ext_ref != nullptr)
+        ext_ref->o = to;
+      insert(alloc, to, ext_ref);
+    }
+
     void erase(Alloc& alloc, Object* p)
     {
       auto it = external_map->find(p);
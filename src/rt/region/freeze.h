@@ -157,6 +157,10 @@ namespace verona::rt
         assert(RegionTrace::is_trace_region(p->get_region()));
         RegionTrace* reg = RegionTrace::get(p);
 
+        // Objects moved into chunks by compaction cannot be deallocated
+        // individually once they are immutable.
+        reg->scatter(alloc, p);
+
         // Drop the ISO mark on the entry point.
         p->init_next(reg);
 
@@ -326,12 +330,13 @@ namespace verona::rt
           p = objects.pop();
         }
 
-        // Finally deallocate objects.
+        // Finally deallocate objects.  Unreachable objects may have been
+        // left in a block by `scatter`.
         while (!to_dealloc.empty())
         {
           Object* q = to_dealloc.pop();
           q->destructor();
-          q->dealloc(alloc);
+          Immutable::dealloc(alloc, q);
         }
 
         reg->discard(alloc);
@@ -16,7 +16,73 @@ namespace verona::rt
 
   class Immutable
   {
+  private:
+    /**
+     * The header of a block of memory holding frozen objects that could not
+     * be moved into allocations of their own when their region was frozen,
+     * see `RegionTrace::scatter`.  It is written over the start of the
+     * block, and the block is deallocated with the last of the objects.
+     */
+    struct Block
+    {
+      /// Number of the objects in the block that are still allocated.
+      std::atomic<size_t> objects;
+      /// Size of the whole block.
+      size_t size;
+
+      Block(size_t objects, size_t size) : objects(objects), size(size) {}
+    };
+
+    /// Number of blocks with objects still allocated.  These are rare, so
+    /// deallocation only looks for the block of an object while there are
+    /// any.
+    inline static std::atomic<size_t> block_count{0};
+
   public:
+    /// Number of bytes at the start of a block that `keep_block` overwrites.
+    static constexpr size_t BLOCK_HEADER = sizeof(Block);
+
+    /**
+     * Records that `objects` objects that are about to be frozen are in the
+     * block of `size` bytes at `start`, so the block is deallocated once
+     * each of them has been deallocated, rather than each object on its own.
+     * The first `BLOCK_HEADER` bytes of the block must not be an object.
+     */
+    static void keep_block(void* start, size_t size, size_t objects)
+    {
+      assert(objects != 0);
+      new (start) Block(objects, size);
+      block_count.fetch_add(1, std::memory_order_release);
+    }
+
+    /**
+     * Deallocates `o`, or, if it is in a block kept by `keep_block`, the
+     * block once its other objects have been deallocated.  Objects in a
+     * block are found as they do not start an allocation of their own.
+     */
+    static void dealloc(Alloc& alloc, Object* o)
+    {
+      std::byte* p = o->real_start();
+      if (block_count.load(std::memory_order_acquire) != 0)
+      {
+        auto start = (std::byte*)alloc.external_pointer<snmalloc::Start>(p);
+        if (start != p)
+        {
+          auto b = (Block*)start;
+          if (b->objects.fetch_sub(1, std::memory_order_acq_rel) == 1)
+          {
+            size_t size = b->size;
+            b->~Block();
+            block_count.fetch_sub(1, std::memory_order_relaxed);
+            alloc.dealloc(start, size);
+          }
+          return;
+        }
+      }
+
+      o->dealloc(alloc);
+    }
+
     static void acquire(Object* o)
     {
       assert(o->debug_is_immutable());
@@ -131,12 +197,12 @@ namespace verona::rt
           Object* w = fl.pop();
           total += w->size();
           w->destructor();
-          w->dealloc(alloc);
+          dealloc(alloc, w);
         }
 
         total += v->size();
         v->destructor();
-        v->dealloc(alloc);
+        dealloc(alloc, v);
       }
 
       assert(f.empty());
@@ -0,0 +1,165 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../object/object.h"
+
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  using namespace snmalloc;
+
+  /**
+   * Dead objects of a region, kept to be reused by later allocations of the
+   * same descriptor in that region instead of being returned to snmalloc.
+   *
+   * Pooling is turned on for each descriptor separately, for up to
+   * `DESCRIPTORS` descriptors in a region, with a limit on the number of
+   * objects kept for each.  The objects of a descriptor are kept in a list
+   * linked through their headers.  A region that pools nothing only pays for
+   * a null pointer.
+   */
+  class ObjectPool
+  {
+  public:
+    /// Number of descriptors whose objects a region can pool.
+    static constexpr size_t DESCRIPTORS = 4;
+
+    /// Number of objects of a descriptor kept by default.
+    static constexpr size_t DEFAULT_LIMIT = 1024;
+
+  private:
+    struct Entry
+    {
+      const Descriptor* desc;
+      Object* head;
+      size_t count;
+      size_t limit;
+    };
+
+    /// Allocated on the first call to `set_limit`.
+    Entry* entries = nullptr;
+
+    Entry* find(const Descriptor* desc)
+    {
+      for (size_t i = 0; i < DESCRIPTORS; i++)
+      {
+        if (entries[i].desc == desc)
+          return &entries[i];
+      }
+      return nullptr;
+    }
+
+    static void clear(Alloc& alloc, Entry& e)
+    {
+      while (e.head != nullptr)
+      {
+        Object* o = e.head;
+        e.head = o->get_next();
+        alloc.dealloc(o->real_start(), e.desc->size);
+      }
+      e.count = 0;
+    }
+
+  public:
+    /**
+     * Keeps up to `limit` dead objects of `desc` for reuse.  A `limit` of 0
+     * stops pooling objects of `desc`, and deallocates those kept.  Returns
+     * false if `DESCRIPTORS` other descriptors are already pooled.
+     */
+    bool set_limit(Alloc& alloc, const Descriptor* desc, size_t limit)
+    {
+      if (entries == nullptr)
+      {
+        if (limit == 0)
+          return true;
+
+        entries = (Entry*)alloc.alloc<DESCRIPTORS * sizeof(Entry)>();
+        for (size_t i = 0; i < DESCRIPTORS; i++)
+          entries[i] = {nullptr, nullptr, 0, 0};
+      }
+
+      Entry* e = find(desc);
+      if (e == nullptr)
+      {
+        if (limit == 0)
+          return true;
+
+        e = find(nullptr);
+        if (e == nullptr)
+          return false;
+        e->desc = desc;
+      }
+
+      e->limit = limit;
+      while (e->count > limit)
+      {
+        Object* o = e->head;
+        e->head = o->get_next();
+        e->count--;
+        alloc.dealloc(o->real_start(), desc->size);
+      }
+
+      if (limit == 0)
+        e->desc = nullptr;
+      return true;
+    }
+
+    /**
+     * Returns the memory of a dead object of `desc`, including its header,
+     * or nullptr if none is kept.
+     */
+    void* take(const Descriptor* desc)
+    {
+      if (entries == nullptr)
+        return nullptr;
+
+      Entry* e = find(desc);
+      if ((e == nullptr) || (e->head == nullptr))
+        return nullptr;
+
+      Object* o = e->head;
+      e->head = o->get_next();
+      e->count--;
+      return o->real_start();
+    }
+
+    /**
+     * Keeps the dead object `o` for reuse if its descriptor is pooled and
+     * below its limit, and otherwise deallocates it.  `o` must have been
+     * allocated by snmalloc on its own, and must have been destroyed.
+     */
+    void recycle(Alloc& alloc, Object* o)
+    {
+      if (entries != nullptr)
+      {
+        Entry* e = find(o->get_descriptor());
+        if ((e != nullptr) && (e->count < e->limit))
+        {
+          o->init_next(e->head);
+          e->head = o;
+          e->count++;
+          return;
+        }
+      }
+
+      o->dealloc(alloc);
+    }
+
+    /// Deallocates all the objects kept, and stops pooling.
+    void dealloc(Alloc& alloc)
+    {
+      if (entries == nullptr)
+        return;
+
+      for (size_t i = 0; i < DESCRIPTORS; i++)
+      {
+        if (entries[i].desc != nullptr)
+          clear(alloc, entries[i]);
+      }
+      alloc.dealloc<DESCRIPTORS * sizeof(Entry)>(entries);
+      entries = nullptr;
+    }
+  };
+} // namespace verona::rt
@@ -53,6 +53,19 @@ namespace verona::rt::api
       {
         return get_region_context().top->region;
       }
+
+      /// Returns true if the current region is also open further down the
+      /// stack of open regions.
+      static bool is_open_below()
+      {
+        RegionFrame* top = get_region_context().top;
+        for (RegionFrame* f = top->prev; f != nullptr; f = f->prev)
+        {
+          if (f->region == top->region)
+            return true;
+        }
+        return false;
+      }
     };
   }
 
@@ -93,6 +106,11 @@ namespace verona::rt::api
 
   /**
    * Close current region
+   *
+   * A trace region set to be collected automatically is collected here, if
+   * it has grown enough, see `RegionTrace::set_auto_gc`.  It is not collected
+   * while it is still open further down, as that code may hold pointers into
+   * it.
    */
   inline void close_region()
   {
@@ -100,6 +118,14 @@ namespace verona::rt::api
     switch (Region::get_type(md))
     {
       case RegionType::Trace:
+      {
+        Object* entry_point = RegionContext::get_entry_point();
+        if (
+          RegionTrace::auto_gc_due(entry_point) &&
+          !RegionContext::is_open_below())
+          RegionTrace::gc(ThreadAlloc::get(), entry_point);
+        break;
+      }
       case RegionType::Arena:
         break;
       case RegionType::Rc:
@@ -235,8 +261,15 @@ namespace verona::rt::api
       ThreadAlloc::get(), o, (RegionRc*)RegionContext::get_region());
   }
 
+  /**
+   * Creates a region of `type`, with an entry point of type `d`.
+   *
+   * `size_hint` is the number of bytes of objects the region is expected to
+   * hold, if known.  An arena region reserves that much up front.
+   */
   template<typename T = Object>
-  inline T* create_fresh_region(RegionType type, const Descriptor* d)
+  inline T* create_fresh_region(
+    RegionType type, const Descriptor* d, size_t size_hint = 0)
   {
     Object* entry_point = nullptr;
     switch (type)
@@ -245,7 +278,7 @@ namespace verona::rt::api
         entry_point = RegionTrace::create(ThreadAlloc::get(), d);
         break;
       case RegionType::Arena:
-        entry_point = RegionArena::create(ThreadAlloc::get(), d);
+        entry_point = RegionArena::create(ThreadAlloc::get(), d, size_hint);
         break;
       case RegionType::Rc:
         entry_point = RegionRc::create(ThreadAlloc::get(), d);
@@ -291,6 +324,69 @@ namespace verona::rt::api
     }
   }
 
+  /**
+   * Keeps up to `limit` dead objects of type `d` in the current region, to be
+   * reused when objects of that type are allocated in it, see `ObjectPool`.
+   * A `limit` of 0 stops this.  Returns false if the region cannot pool
+   * objects of another type, or does not free objects on its own.
+   **/
+  inline bool
+  region_pool(const Descriptor* d, size_t limit = ObjectPool::DEFAULT_LIMIT)
+  {
+    RegionBase* r = RegionContext::get_region();
+    switch (Region::get_type(r))
+    {
+      case RegionType::Trace:
+      case RegionType::Rc:
+        return r->ObjectPool::set_limit(ThreadAlloc::get(), d, limit);
+      case RegionType::Arena:
+        // Objects are only freed with the whole region.
+        return false;
+    }
+    // Unreachable as case is exhaustive
+    abort();
+  }
+
+  /**
+   * Sets the current region to be collected automatically when it is closed,
+   * once it has grown by `growth_percent` percent since it was last
+   * collected.  A `growth_percent` of 0 turns this off.  This has no effect
+   * on arena regions, which are only freed as a whole, or on RC regions,
+   * which free objects as soon as they are unreachable.
+   **/
+  inline void region_auto_gc(size_t growth_percent)
+  {
+    switch (Region::get_type(RegionContext::get_region()))
+    {
+      case RegionType::Trace:
+        RegionTrace::set_auto_gc(
+          RegionContext::get_entry_point(), growth_percent);
+        break;
+      case RegionType::Arena:
+        // Nothing to collect here!
+        break;
+      case RegionType::Rc:
+        // Objects are freed when their count reaches zero.  Cycles are only
+        // collected by an explicit `region_collect`.
+        break;
+    }
+  }
+
+  /**
+   * Collects the current region.  A trace region is then compacted, see
+   * `RegionTrace::compact`.
+   **/
+  inline void region_compact()
+  {
+    if (Region::get_type(RegionContext::get_region()) == RegionType::Trace)
+    {
+      RegionTrace::compact(
+        ThreadAlloc::get(), RegionContext::get_entry_point());
+    }
+    else
+      region_collect();
+  }
+
   template<typename T = Object>
   inline void region_release(Object* r)
   {
@@ -328,4 +424,4 @@ namespace verona::rt::api
         abort();
     }
   }
-} // namespace verona::rt
\ No newline at end of file
+} // namespace verona::rt
\ No newline at end of file
@@ -27,6 +27,12 @@ namespace verona::rt
    * then allocate the object within the new arena. Note that we do not do
    * first fit or best fit.
    *
+   * Arenas grow geometrically: each new arena is twice the size of the one
+   * before, from `MIN_ARENA_SIZE` up to `MAX_ARENA_SIZE`, so that a region
+   * with a few small objects stays small, while a large region needs few
+   * arenas. A size hint can be given when the region is created, to start
+   * with an arena large enough for that much.
+   *
    * Note that if the Iso is allocated within an arena, it will still point to
    * the arena region object.
    *
@@ -46,17 +52,24 @@ namespace verona::rt
     template<IteratorType type>
     class iterator;
 
+    /// Size of the first arena of a region, including its header.
+    static constexpr size_t MIN_ARENA_SIZE = 4 * 1024;
+
+    /// Size that arenas stop growing at, including the header.
+    static constexpr size_t MAX_ARENA_SIZE = 4 * 1024 * 1024;
+
   private:
     friend class Region;
     friend class RegionTrace;
     friend class RegionRc;
 
     /**
-     * An Arena is a large block of pre-allocated memory. It has an overhead of
-     * four pointers: the next Arena in the linked list, and three pointers to
-     * keep track of where objects are allocated. The next pointers of all
-     * objects inside an arena are set to nullptr. An initialized arena is
-     * guaranteed to have at least one object.
+     * An Arena is a block of pre-allocated memory. It has an overhead of four
+     * pointers: the next Arena in the linked list, and three pointers to keep
+     * track of where objects are allocated. The objects follow this header, up
+     * to the end of the block. The next pointers of all objects inside an
+     * arena are set to nullptr. An initialized arena is guaranteed to have at
+     * least one object.
      *
      * Trivial objects (ie. those with no destructor, no finaliser and no iso
      * fields) are allocated from the beginning of the arena, starting at
@@ -117,7 +130,12 @@ namespace verona::rt
       friend class RegionArena::iterator;
 
     public:
-      static constexpr size_t SIZE = 1024 * 1024 - 4 * sizeof(uintptr_t);
+      /// Size of the header before the objects.
+      static constexpr size_t HEADER_SIZE = 4 * sizeof(uintptr_t);
+
+      /// Objects larger than this are put in the large object ring, rather
+      /// than in an arena.
+      static constexpr size_t MAX_OBJECT_SIZE = 1024 * 1024 - HEADER_SIZE;
 
       /**
        * Pointer to next arena in the linked list.
@@ -137,25 +155,35 @@ namespace verona::rt
       std::byte* non_trivial_begin;
 
       /**
-       * Pointer to the byte after the Arena. We technically don't need to
-       * store this pointer, but we have some space because `objects_begin`
-       * needs to be aligned.
+       * Pointer to the byte after the Arena, which also gives its size.
        **/
       std::byte* non_trivial_end;
 
+    public:
       /**
-       * Where objects will actually be allocated.
+       * Initialises an arena at the start of a block of `size` bytes.
        **/
-      alignas(Object::ALIGNMENT) std::byte objects_begin[SIZE];
-
-    public:
-      Arena()
+      Arena(size_t size)
       : next(nullptr),
-        objects_end(objects_begin),
-        non_trivial_begin(objects_begin + SIZE),
+        objects_end(objects_begin()),
+        non_trivial_begin((std::byte*)this + size),
         non_trivial_end(non_trivial_begin)
       {
-        assert(free_space() == SIZE);
+        assert(free_space() == size - HEADER_SIZE);
+      }
+
+      /**
+       * Where objects will actually be allocated.
+       **/
+      std::byte* objects_begin() const
+      {
+        return (std::byte*)this + HEADER_SIZE;
+      }
+
+      /// Size of the whole block, including the header.
+      size_t size() const
+      {
+        return (size_t)(non_trivial_end - (std::byte*)this);
       }
 
       inline size_t free_space() const
@@ -204,10 +232,10 @@ namespace verona::rt
     private:
       bool debug_invariant() const
       {
-        bool objects_ptrs = objects_begin <= objects_end;
+        bool objects_ptrs = objects_begin() <= objects_end;
         bool non_trivial_ptrs = non_trivial_begin <= non_trivial_end;
         bool no_overlap = (non_trivial_begin - objects_end) >= 0;
-        auto alignment1 = Object::debug_is_aligned(objects_begin);
+        auto alignment1 = Object::debug_is_aligned(objects_begin());
         auto alignment2 = Object::debug_is_aligned(objects_end);
         auto alignment3 = Object::debug_is_aligned(non_trivial_begin);
         auto alignment4 = Object::debug_is_aligned(non_trivial_end);
@@ -215,7 +243,8 @@ namespace verona::rt
           alignment2 && alignment3 && alignment4;
       }
     };
-    static_assert(sizeof(Arena) == 1024 * 1024 * sizeof(std::byte));
+    static_assert(sizeof(Arena) == Arena::HEADER_SIZE);
+    static_assert(Arena::HEADER_SIZE % Object::ALIGNMENT == 0);
 
     /**
      * Pointer to the linked list of arenas where objects are allocated in.
@@ -237,15 +266,32 @@ namespace verona::rt
      **/
     Object* last_large;
 
-    RegionArena()
+    /**
+     * Size of the next arena to allocate, including its header.
+     **/
+    size_t next_arena_size;
+
+    RegionArena(size_t size_hint)
     : RegionBase(),
       first_arena(nullptr),
       last_arena(nullptr),
-      last_large(nullptr)
+      last_large(nullptr),
+      next_arena_size(first_arena_size(size_hint))
     {
       init_next(this);
     }
 
+    /**
+     * Returns the size of the first arena for a region that expects to hold
+     * `size_hint` bytes of objects.
+     **/
+    static size_t first_arena_size(size_t size_hint)
+    {
+      if (size_hint <= MIN_ARENA_SIZE - Arena::HEADER_SIZE)
+        return MIN_ARENA_SIZE;
+      return bits::next_pow2(size_hint + Arena::HEADER_SIZE);
+    }
+
     static const Descriptor* desc()
     {
       static constexpr Descriptor desc = {
@@ -272,16 +318,21 @@ namespace verona::rt
      * object is initialised as the Iso object for that region, and points to a
      * newly created Region metadata object. Returns a pointer to `o`.
      *
+     * `size_hint` is the number of bytes of objects the region is expected to
+     * hold, which its first arena is made large enough for. If it is 0, the
+     * first arena is `MIN_ARENA_SIZE` bytes.
+     *
      * The default template parameter `size = 0` is to avoid writing two
      * definitions which differ only in one line. This overload works because
      * every object must contain a descriptor, so 0 is not a valid size.
      **/
     template<size_t size = 0>
-    static Object* create(Alloc& alloc, const Descriptor* desc)
+    static Object*
+    create(Alloc& alloc, const Descriptor* desc, size_t size_hint = 0)
     {
       void* p = Object::register_object(
         alloc.alloc<vsizeof<RegionArena>>(), RegionArena::desc());
-      RegionArena* reg = new (p) RegionArena();
+      RegionArena* reg = new (p) RegionArena(size_hint);
 
       // o might be allocated in the arena or the large object ring.
       Object* o = reg->alloc_internal<size>(alloc, desc);
@@ -358,7 +409,7 @@ namespace verona::rt
       // Clear the iso bit on `o`, if it's inside an arena. Otherwise, it's in
       // the large object ring and pointing to some other object.
       size_t sz = snmalloc::bits::align_up(o->size(), Object::ALIGNMENT);
-      if (sz <= Arena::SIZE)
+      if (sz <= Arena::MAX_OBJECT_SIZE)
         o->init_next(nullptr);
 
       // Merge the ExternalRefTable and RememberedSet.
@@ -412,7 +463,8 @@ namespace verona::rt
      * and the object is added to the large object ring.
      *
      * Otherwise, we check if the last arena has space. If so, the object is
-     * allocated there. If not, we allocate a new arena.
+     * allocated there. If not, we allocate a new arena, of `next_arena_size`
+     * or larger if the object does not fit in that.
      *
      * TODO(region): For now, we guarantee constant-time allocation and accept
      * that we will have fragmentation. Later, we could try other strategies,
@@ -424,7 +476,7 @@ namespace verona::rt
       assert((size == 0) || (desc->size == size));
 
       auto sz = size == 0 ? desc->size : size;
-      if (sz > Arena::SIZE)
+      if (sz > Arena::MAX_OBJECT_SIZE)
       {
         // Allocate object.
         void* p = nullptr;
@@ -445,8 +497,13 @@ namespace verona::rt
       // allocate a new arena.
       if (last_arena == nullptr || last_arena->free_space() < sz)
       {
-        void* p = alloc.alloc<sizeof(Arena)>();
-        Arena* a = new (p) Arena();
+        size_t arena_size = next_arena_size;
+        while (arena_size - Arena::HEADER_SIZE < sz)
+          arena_size *= 2;
+        next_arena_size = bits::min(arena_size * 2, MAX_ARENA_SIZE);
+
+        void* p = alloc.alloc(arena_size);
+        Arena* a = new (p) Arena(arena_size);
 
         if (last_arena == nullptr)
         {
@@ -502,7 +559,7 @@ namespace verona::rt
       size_t nroot_size =
         snmalloc::bits::align_up(nroot->size(), Object::ALIGNMENT);
 
-      if (oroot_size <= Arena::SIZE)
+      if (oroot_size <= Arena::MAX_OBJECT_SIZE)
       {
         // Old root is inside an arena, so we set its next to nullptr.
         oroot->init_next(nullptr);
@@ -511,7 +568,7 @@ namespace verona::rt
       {
         // Old root is in the large object ring.
         assert(oroot == last_large);
-        if (nroot_size <= Arena::SIZE)
+        if (nroot_size <= Arena::MAX_OBJECT_SIZE)
         {
           // Clear the iso bit on the old root.
           oroot->init_next(this);
@@ -520,7 +577,7 @@ namespace verona::rt
 
       // New root is in the large object ring, need to move it to the last
       // position in the ring. Don't do anything if it's already last.
-      if (nroot != last_large && nroot_size > Arena::SIZE)
+      if (nroot != last_large && nroot_size > Arena::MAX_OBJECT_SIZE)
       {
         Object* x = get_next();
         Object* y = nroot->get_next();
@@ -585,7 +642,7 @@ namespace verona::rt
       while (arena != nullptr)
       {
         Arena* q = arena->next;
-        alloc.dealloc<sizeof(Arena)>(arena);
+        alloc.dealloc(arena, arena->size());
         arena = q;
       }
 
@@ -667,7 +724,7 @@ namespace verona::rt
         std::byte* q = ptr->real_start() + sz;
         if constexpr (type == Trivial)
         {
-          assert(q > arena->objects_begin && q <= arena->objects_end);
+          assert(q > arena->objects_begin() && q <= arena->objects_end);
 
           // We have not yet reached the end, so q is valid.
           if (q != arena->objects_end)
@@ -684,7 +741,7 @@ namespace verona::rt
         else if constexpr (type == AllObjects)
         {
           assert(
-            (q > arena->objects_begin && q <= arena->objects_end) ||
+            (q > arena->objects_begin() && q <= arena->objects_end) ||
             (q > arena->non_trivial_begin && q <= arena->non_trivial_end));
 
           // We have not yet reached either end, so q is valid.
@@ -735,15 +792,15 @@ namespace verona::rt
         while (arena != nullptr)
         {
           assert(
-            arena->objects_begin < arena->objects_end ||
+            arena->objects_begin() < arena->objects_end ||
             arena->non_trivial_begin < arena->non_trivial_end);
           assert(arena->debug_invariant());
           if constexpr (type == Trivial || type == AllObjects)
           {
-            if (arena->objects_begin != arena->objects_end)
+            if (arena->objects_begin() != arena->objects_end)
               // objects_begin points to header of first object.
               // we return the actually Object*.
-              return Object::object_start(arena->objects_begin);
+              return Object::object_start(arena->objects_begin());
           }
           if constexpr (type == NonTrivial || type == AllObjects)
           {
@@ -797,6 +854,24 @@ namespace verona::rt
       return {this, nullptr, nullptr};
     }
 
+    /// Returns the number of arenas in the region.
+    size_t debug_arena_count()
+    {
+      size_t count = 0;
+      for (Arena* a = first_arena; a != nullptr; a = a->next)
+        count++;
+      return count;
+    }
+
+    /// Returns the total size of the arenas in the region.
+    size_t debug_arena_memory()
+    {
+      size_t size = 0;
+      for (Arena* a = first_arena; a != nullptr; a = a->next)
+        size += a->size();
+      return size;
+    }
+
   private:
     bool debug_is_in_region(Object* o)
     {
@@ -4,6 +4,7 @@
 
 #include "../object/object.h"
 #include "externalreference.h"
+#include "objectpool.h"
 #include "rememberedset.h"
 
 namespace verona::rt
@@ -28,7 +29,8 @@ namespace verona::rt
 
   class RegionBase : public Object,
                      public ExternalReferenceTable,
-                     public RememberedSet
+                     public RememberedSet,
+                     public ObjectPool
   {
     friend class Freeze;
     friend class RegionTrace;
@@ -50,6 +52,7 @@ namespace verona::rt
     {
       ExternalReferenceTable::dealloc(alloc);
       RememberedSet::dealloc(alloc);
+      ObjectPool::dealloc(alloc);
       Object::dealloc(alloc);
     }
   };
@@ -122,11 +122,14 @@ namespace verona::rt
       assert((size == 0) || (size == desc->size));
       assert(reg != nullptr);
 
-      void* p = nullptr;
-      if constexpr (size == 0)
-        p = alloc.alloc(desc->size);
-      else
-        p = alloc.alloc<size>();
+      void* p = reg->ObjectPool::take(desc);
+      if (p == nullptr)
+      {
+        if constexpr (size == 0)
+          p = alloc.alloc(desc->size);
+        else
+          p = alloc.alloc<size>();
+      }
 
       auto o = (Object*)Object::register_object(p, desc);
       assert(Object::debug_is_aligned(o));
@@ -569,7 +572,7 @@ namespace verona::rt
         Object* o = gc.pop();
         reg->region_size -= 1;
         o->destructor();
-        o->dealloc(alloc);
+        reg->ObjectPool::recycle(alloc, o);
       }
     }
 
@@ -637,7 +640,7 @@ namespace verona::rt
         Object* o = gc.pop();
         reg->region_size -= 1;
         o->destructor();
-        o->dealloc(alloc);
+        reg->ObjectPool::recycle(alloc, o);
       }
 
       release_sub_regions(alloc, sub_regions);
@@ -6,6 +6,9 @@
 #include "region_arena.h"
 #include "region_base.h"
 
+#include <algorithm>
+#include <cstring>
+
 namespace verona::rt
 {
   using namespace snmalloc;
@@ -58,6 +61,15 @@ namespace verona::rt
       NonTrivialRing,
     };
 
+    /// Memory used after the last collection is taken to be at least this
+    /// much when deciding whether to collect automatically, so that small
+    /// regions are not collected every time they are closed.
+    static constexpr size_t AUTO_GC_MIN_MEMORY = 64 * 1024;
+
+    /// Number of objects taken from the mark stack and prefetched before the
+    /// first of them is marked, see `mark`.  Must be a power of two.
+    static constexpr size_t MARK_PREFETCH_DISTANCE = 8;
+
     // Circular linked list ("secondary ring") for trivial objects if the root
     // is trivial, or vice versa.
     Object* next_not_root;
@@ -67,11 +79,38 @@ namespace verona::rt
     size_t current_memory_used = 0;
 
     // Compact representation of previous memory used as a sizeclass.
-    snmalloc::sizeclass_t previous_memory_used;
+    snmalloc::sizeclass_t previous_memory_used = 0;
+
+    // Growth in memory used since the last collection, as a percentage, at
+    // which the region is collected automatically, or 0 if it is not.
+    size_t auto_gc_growth = 0;
 
     // Stack of stack based entry points into the region.
     StackThin<Object, Alloc> additional_entry_points{};
 
+    /// A block of memory that objects were moved into by `compact`.  The
+    /// objects follow the header, and are not deallocated individually.  A
+    /// chunk is deallocated by the next compaction, which moves its live
+    /// objects out, or when the region is released or frozen.
+    struct Chunk
+    {
+      /// Size of the whole allocation, including this header.
+      size_t size;
+      /// Number of objects left in the chunk by `scatter`.
+      size_t kept;
+    };
+
+    static constexpr size_t CHUNK_HEADER =
+      bits::align_up(sizeof(Chunk), Object::ALIGNMENT);
+    static_assert(
+      CHUNK_HEADER >= Immutable::BLOCK_HEADER,
+      "A chunk kept when frozen must have room for the block header.");
+
+    // Chunks holding objects moved by compaction, sorted by address, so the
+    // chunk holding an object is found by a binary search.
+    Chunk** chunks = nullptr;
+    size_t chunk_count = 0;
+
     explicit RegionTrace()
     : RegionBase(), next_not_root(this), last_not_root(this)
     {}
@@ -145,11 +184,14 @@ namespace verona::rt
 
       assert(reg != nullptr);
 
-      void* p = nullptr;
-      if constexpr (size == 0)
-        p = alloc.alloc(desc->size);
-      else
-        p = alloc.alloc<size>();
+      void* p = reg->ObjectPool::take(desc);
+      if (p == nullptr)
+      {
+        if constexpr (size == 0)
+          p = alloc.alloc(desc->size);
+        else
+          p = alloc.alloc<size>();
+      }
 
       auto o = (Object*)Object::register_object(p, desc);
       assert(Object::debug_is_aligned(o));
@@ -201,7 +243,7 @@ namespace verona::rt
         if (!other_trace->additional_entry_points.empty())
           abort();
 
-        reg->merge_internal(o, other_trace);
+        reg->merge_internal(alloc, o, other_trace);
 
         // Merge the ExternalReferenceTable and RememberedSet.
         reg->ExternalReferenceTable::merge(alloc, other_trace);
@@ -280,6 +322,57 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Run a garbage collection on the region represented by the Object `o`,
+     * and then move the objects that are left into a single chunk, in the
+     * order in which they are reached from `o`.  Objects allocated one at a
+     * time become scattered over the heap as the region lives on, so this
+     * packs them densely again for later traversals.
+     *
+     * `o` itself is not moved.  All other objects are moved, so each must
+     * have a relocate function, see `Descriptor::RelocateFunction`, and the
+     * only pointers into the region from outside, other than to `o`, must be
+     * external references.  If the region has additional roots, or any of
+     * its objects has no relocate function, only the collection is done.
+     **/
+    static void compact(Alloc& alloc, Object* o)
+    {
+      gc(alloc, o);
+
+      RegionTrace* reg = get(o);
+      if (reg->additional_entry_points.empty())
+        reg->compact_internal(alloc, o);
+    }
+
+    /**
+     * Sets the region represented by the Iso Object `o` to be collected
+     * automatically, once the memory allocated in it has grown by
+     * `growth_percent` percent since it was last collected.  A
+     * `growth_percent` of 0 turns this off.
+     *
+     * The collection is run when the region is closed, see
+     * `api::close_region`, as the code that used it should then no longer
+     * hold pointers into it other than its roots.
+     **/
+    static void set_auto_gc(Object* o, size_t growth_percent)
+    {
+      get(o)->auto_gc_growth = growth_percent;
+    }
+
+    /// Returns true if the region represented by the Iso Object `o` is set
+    /// to be collected automatically, and has grown enough to be collected.
+    static bool auto_gc_due(Object* o)
+    {
+      RegionTrace* reg = get(o);
+      if (reg->auto_gc_growth == 0)
+        return false;
+
+      size_t previous = std::max(
+        sizeclass_full_to_size(reg->previous_memory_used), AUTO_GC_MIN_MEMORY);
+      return reg->current_memory_used >
+        previous + previous / 100 * reg->auto_gc_growth;
+    }
+
     /// Add object `o` to the additional root stack of the region referenced to
     /// by `entry`.
     /// Preserves for object for a GC.
@@ -331,7 +424,7 @@ namespace verona::rt
       }
     }
 
-    void merge_internal(Object* o, RegionTrace* other)
+    void merge_internal(Alloc& alloc, Object* o, RegionTrace* other)
     {
       assert(o->get_region() == other);
       Object* head;
@@ -346,11 +439,23 @@ namespace verona::rt
       if (head != other)
         append(head, other->last_not_root);
 
+      // Take over the chunks of objects moved by compaction.
+      if (other->chunk_count != 0)
+      {
+        size_t count = chunk_count + other->chunk_count;
+        auto cs = (Chunk**)alloc.alloc(count * sizeof(Chunk*));
+        std::copy(chunks, chunks + chunk_count, cs);
+        std::copy(
+          other->chunks, other->chunks + other->chunk_count, cs + chunk_count);
+        other->set_chunks(alloc, nullptr, 0);
+        set_chunks(alloc, cs, count);
+      }
+
       // Update memory usage.
       current_memory_used += other->current_memory_used;
 
       previous_memory_used = size_to_sizeclass_full(
-        sizeclass_full_to_size(other->previous_memory_used) +
+        sizeclass_full_to_size(previous_memory_used) +
         sizeclass_full_to_size(other->previous_memory_used));
     }
 
@@ -397,38 +502,70 @@ namespace verona::rt
      * Scan through the region and mark all objects reachable from the iso
      * object `o`. We don't follow pointers to subregions. Also will trace
      * from anything already in `dfs`.
+     *
+     * The time to mark is dominated by cache misses on the headers of the
+     * objects, rather than by the work on each.  So objects taken from `dfs`
+     * are prefetched, and wait in a small FIFO until `MARK_PREFETCH_DISTANCE`
+     * more have been taken, by when their headers are likely to be in cache.
      **/
     void mark(Alloc& alloc, Object* o, ObjectStack& dfs)
     {
+      static constexpr size_t mask = MARK_PREFETCH_DISTANCE - 1;
+      static_assert((MARK_PREFETCH_DISTANCE & mask) == 0);
+
+      Object* fifo[MARK_PREFETCH_DISTANCE];
+      size_t head = 0;
+      size_t count = 0;
+
       o->trace(dfs);
-      while (!dfs.empty())
+      while (true)
       {
-        Object* p = dfs.pop();
-        switch (p->get_class())
+        while ((count < MARK_PREFETCH_DISTANCE) && !dfs.empty())
         {
-          case Object::ISO:
-          case Object::MARKED:
-            break;
-
-          case Object::UNMARKED:
-            Logging::cout() << "Mark" << p << Logging::endl;
-            p->mark();
-            p->trace(dfs);
-            break;
+          Object* p = dfs.pop();
+          Aal::prefetch(p);
+          fifo[(head + count) & mask] = p;
+          count++;
+        }
 
-          case Object::SCC_PTR:
-            p = p->immutable();
-            RememberedSet::mark(alloc, p);
-            break;
+        if (count == 0)
+          break;
 
-          case Object::RC:
-          case Object::COWN:
-            RememberedSet::mark(alloc, p);
-            break;
+        Object* p = fifo[head];
+        head = (head + 1) & mask;
+        count--;
+        mark_object(alloc, p, dfs);
+      }
+    }
 
-          default:
-            assert(0);
-        }
+    /// Marks `p` and pushes the objects it refers to onto `dfs`, if it is in
+    /// this region and not yet marked.
+    void mark_object(Alloc& alloc, Object* p, ObjectStack& dfs)
+    {
+      switch (p->get_class())
+      {
+        case Object::ISO:
+        case Object::MARKED:
+          break;
+
+        case Object::UNMARKED:
+          Logging::cout() << "Mark" << p << Logging::endl;
+          p->mark();
+          p->trace(dfs);
+          break;
+
+        case Object::SCC_PTR:
+          p = p->immutable();
+          RememberedSet::mark(alloc, p);
+          break;
+
+        case Object::RC:
+        case Object::COWN:
+          RememberedSet::mark(alloc, p);
+          break;
+
+        default:
+          assert(0);
       }
     }
 
@@ -490,7 +627,7 @@ namespace verona::rt
         if (p->has_ext_ref())
           ExternalReferenceTable::erase(alloc, p);
 
-        p->dealloc(alloc);
+        dealloc_object(alloc, p);
       }
       else
       {
@@ -518,6 +655,10 @@ namespace verona::rt
       // deallocate objects from the rings.
       while (p != this)
       {
+        // The ring can only be walked by following `next`, so start loading
+        // the next object while this one is swept.
+        Aal::prefetch(p->get_next_any_mark());
+
         switch (p->get_class())
         {
           case Object::ISO:
@@ -581,7 +722,7 @@ namespace verona::rt
         {
           Object* q = gc.pop();
           q->destructor();
-          q->dealloc(alloc);
+          dealloc_object(alloc, q);
         }
       }
       else
@@ -613,12 +754,262 @@ namespace verona::rt
 
       Logging::cout() << "Region release: trace region: " << o << Logging::endl;
 
+      // Nothing more will be allocated, so stop keeping objects for reuse.
+      ObjectPool::dealloc(alloc);
+
       // Sweep everything, including the entrypoint.
       sweep<SweepAll::Yes>(alloc, o, collect);
 
+      dealloc_chunks(alloc);
       dealloc(alloc);
     }
 
+    /// Returns the chunk holding `p`, or nullptr if it is not in one.
+    Chunk* find_chunk(Object* p)
+    {
+      std::byte* start = p->real_start();
+      Chunk** after = std::upper_bound(
+        chunks, chunks + chunk_count, start, [](std::byte* a, Chunk* c) {
+          return a < (std::byte*)c;
+        });
+      if (after == chunks)
+        return nullptr;
+
+      Chunk* c = *(after - 1);
+      return (start < (std::byte*)c + c->size) ? c : nullptr;
+    }
+
+    bool in_chunk(Object* p)
+    {
+      return (chunk_count != 0) && (find_chunk(p) != nullptr);
+    }
+
+    /// Replaces the array of chunks with the `count` chunks in `cs`, which
+    /// is taken over.  The chunks in the previous array are not deallocated.
+    void set_chunks(Alloc& alloc, Chunk** cs, size_t count)
+    {
+      if (chunk_count != 0)
+        alloc.dealloc(chunks, chunk_count * sizeof(Chunk*));
+
+      std::sort(cs, cs + count);
+      chunks = cs;
+      chunk_count = count;
+    }
+
+    /// Deallocates `p`, or keeps it for reuse, unless it is in a chunk.
+    void dealloc_object(Alloc& alloc, Object* p)
+    {
+      if (!in_chunk(p))
+        ObjectPool::recycle(alloc, p);
+    }
+
+    void dealloc_chunks(Alloc& alloc)
+    {
+      for (size_t i = 0; i < chunk_count; i++)
+        alloc.dealloc(chunks[i], chunks[i]->size);
+      set_chunks(alloc, nullptr, 0);
+    }
+
+    /// Empties both rings, leaving only the iso object `o`.
+    void reset_rings(Object* o)
+    {
+      set_next(o);
+      next_not_root = this;
+      last_not_root = this;
+    }
+
+    /**
+     * Copies `p` to the memory at `to`, and leaves a forwarding pointer in
+     * `p` for `ObjectRelocator`.  Returns the copy.
+     **/
+    Object* move_object(Alloc& alloc, Object* p, void* to)
+    {
+      std::memcpy(to, p->real_start(), p->size());
+      Object* q = Object::object_start(to);
+
+      if (p->has_ext_ref())
+        ExternalReferenceTable::move(alloc, p, q);
+
+      Logging::cout() << "Move " << p << " to " << q << Logging::endl;
+      p->set_forward(q);
+      return q;
+    }
+
+    /// Points the fields of every object in the region that has a relocate
+    /// function at the new copies of the objects that have been moved.
+    void relocate_all()
+    {
+      ObjectRelocator r;
+      for (auto p : *this)
+      {
+        if (p->has_relocate())
+          p->relocate(r);
+      }
+    }
+
+    /**
+     * Moves all objects in the region except its iso object `o` into a new
+     * chunk, in depth first order from `o`.  Must be called just after a
+     * collection with no additional roots, so every object in the rings is
+     * reachable from `o`.
+     **/
+    void compact_internal(Alloc& alloc, Object* o)
+    {
+      size_t size = 0;
+      for (auto p : *this)
+      {
+        if (!p->has_relocate())
+        {
+          Logging::cout() << "Region compact: cannot move " << p
+                          << Logging::endl;
+          return;
+        }
+
+        if (p != o)
+          size += bits::align_up(p->size(), Object::ALIGNMENT);
+      }
+
+      Logging::cout() << "Region compact: " << o << " moving " << size
+                      << " bytes" << Logging::endl;
+
+      Chunk* chunk = nullptr;
+      std::byte* bump = nullptr;
+      if (size != 0)
+      {
+        size_t chunk_size = CHUNK_HEADER + size;
+        chunk = (Chunk*)alloc.alloc(chunk_size);
+        chunk->size = chunk_size;
+        chunk->kept = 0;
+        bump = (std::byte*)chunk + CHUNK_HEADER;
+      }
+
+      // The copies are added back to the rings as they are made.  Only
+      // objects in this region are UNMARKED, and they are MARKED once they
+      // have been moved.
+      reset_rings(o);
+
+      ObjectStack dfs(alloc);
+      ObjectStack moved(alloc);
+      o->trace(dfs);
+      while (!dfs.empty())
+      {
+        Object* p = dfs.pop();
+        if (p->get_class() != Object::UNMARKED)
+          continue;
+
+        p->trace(dfs);
+        size_t p_size = bits::align_up(p->size(), Object::ALIGNMENT);
+        append(move_object(alloc, p, bump));
+        bump += p_size;
+        moved.push(p);
+      }
+      assert((chunk == nullptr) || (bump == (std::byte*)chunk + chunk->size));
+
+      relocate_all();
+
+      // The old copies are not reused, as they are scattered.
+      while (!moved.empty())
+      {
+        Object* p = moved.pop();
+        if (!in_chunk(p))
+          p->dealloc(alloc);
+      }
+
+      // The old chunks are now empty, unless `o` has been swapped in as the
+      // root from one of them.
+      Chunk* keep = in_chunk(o) ? find_chunk(o) : nullptr;
+      for (size_t i = 0; i < chunk_count; i++)
+      {
+        if (chunks[i] != keep)
+          alloc.dealloc(chunks[i], chunks[i]->size);
+      }
+
+      size_t count = (keep != nullptr) + (chunk != nullptr);
+      Chunk** cs = nullptr;
+      if (count != 0)
+      {
+        cs = (Chunk**)alloc.alloc(count * sizeof(Chunk*));
+        size_t i = 0;
+        if (keep != nullptr)
+          cs[i++] = keep;
+        if (chunk != nullptr)
+          cs[i++] = chunk;
+      }
+      set_chunks(alloc, cs, count);
+    }
+
+    /**
+     * Moves the objects in chunks back into allocations of their own, so
+     * they can be deallocated one at a time.  This is needed before the
+     * region is frozen, as immutable objects are deallocated individually.
+     *
+     * Objects in chunks all have relocate functions, as `compact` only moves
+     * those.  The iso object `o` cannot be moved, nor can objects referred
+     * to by objects without a relocate function, which may have been added
+     * to the region since it was compacted.  These are left where they are,
+     * and their chunks are handed to `Immutable::keep_block`.
+     **/
+    void scatter(Alloc& alloc, Object* o)
+    {
+      if (chunk_count == 0)
+        return;
+
+      ObjectStack objects(alloc);
+      ObjectStack refs(alloc);
+      for (auto p : *this)
+      {
+        if (p != o)
+          objects.push(p);
+
+        if (!p->has_relocate())
+          p->trace(refs);
+      }
+
+      // Objects that cannot be moved are marked until the rings are rebuilt.
+      while (!refs.empty())
+      {
+        Object* p = refs.pop();
+        if ((p->get_class() == Object::UNMARKED) && in_chunk(p))
+          p->mark();
+      }
+
+      for (size_t i = 0; i < chunk_count; i++)
+        chunks[i]->kept = 0;
+
+      if (in_chunk(o))
+        find_chunk(o)->kept++;
+
+      reset_rings(o);
+      while (!objects.empty())
+      {
+        Object* p = objects.pop();
+        if (p->get_class() == Object::MARKED)
+        {
+          p->unmark();
+          find_chunk(p)->kept++;
+        }
+        else if (in_chunk(p))
+          p = move_object(alloc, p, alloc.alloc(p->size()));
+        append(p);
+      }
+
+      relocate_all();
+
+      for (size_t i = 0; i < chunk_count; i++)
+      {
+        Chunk* c = chunks[i];
+        if (c->kept != 0)
+        {
+          Logging::cout() << "Region scatter: keeping " << c->kept
+                          << " objects in " << c << Logging::endl;
+          Immutable::keep_block(c, c->size, c->kept);
+        }
+        else
+          alloc.dealloc(c, c->size);
+      }
+      set_chunks(alloc, nullptr, 0);
+    }
+
     void use_memory(size_t size)
     {
       current_memory_used += size;
@@ -0,0 +1,136 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * Limits how many messages a cown processes each time it is run, before
+   * it goes back to the scheduler queue.
+   *
+   * A larger batch amortises the cost of rescheduling over more messages,
+   * while a smaller batch lets the other cowns in the queue run sooner.  The
+   * limit can be
+   *
+   *   - a number of messages,
+   *   - a time slice, checked after each message, or
+   *   - adaptive, where a number of messages is derived from a target time
+   *     slice and the average duration of the cown's behaviours.  This only
+   *     reads the clock at the start and end of each batch.
+   *
+   * Each cown has its own limit, which is also used to track the average
+   * duration of its behaviours in the adaptive mode.
+   */
+  class BatchLimit
+  {
+  public:
+    enum Mode : uint8_t
+    {
+      Count,
+      Time,
+      Adaptive
+    };
+
+    /// Number of messages processed by default, and the starting point for
+    /// the adaptive mode.
+    static constexpr uint32_t DEFAULT_COUNT = 100;
+
+    /// Largest number of messages the adaptive mode will process in a batch.
+    static constexpr uint32_t MAX_ADAPTIVE_COUNT = 10'000;
+
+  private:
+    /// Messages per batch.  Derived from `slice` in the adaptive mode.
+    uint32_t count = DEFAULT_COUNT;
+    /// Time slice in ticks, for the time and adaptive modes.
+    uint32_t slice = 0;
+    /// Moving average of ticks per message, for the adaptive mode.
+    uint32_t average = 0;
+    Mode mode = Count;
+
+    BatchLimit(Mode mode, uint32_t count, uint32_t slice)
+    : count(count), slice(slice), mode(mode)
+    {}
+
+  public:
+    BatchLimit() = default;
+
+    /// Process at most `count` messages each time the cown runs.
+    static BatchLimit messages(uint32_t count)
+    {
+      assert(count > 0);
+      return {Count, count, 0};
+    }
+
+    /// Process messages until `ticks` have passed each time the cown runs.
+    /// At least one message is always processed.
+    static BatchLimit time_slice(uint32_t ticks)
+    {
+      return {Time, DEFAULT_COUNT, ticks};
+    }
+
+    /// Process about as many messages as fit in `ticks`, based on the
+    /// average time the cown's behaviours have taken.
+    static BatchLimit adaptive(uint32_t ticks)
+    {
+      return {Adaptive, DEFAULT_COUNT, ticks};
+    }
+
+    Mode get_mode() const
+    {
+      return mode;
+    }
+
+    /// Returns the largest number of messages to process in a batch.  In the
+    /// time mode, this is unbounded.
+    size_t max_messages() const
+    {
+      return (mode == Time) ? SIZE_MAX : count;
+    }
+
+    /// Returns true if the clock should be read at the start of a batch.
+    bool is_timed() const
+    {
+      return mode != Count;
+    }
+
+    /// In the time mode, returns true if a batch that started at `start`
+    /// has used its slice.
+    bool slice_used(uint64_t start) const
+    {
+      return (mode == Time) && ((snmalloc::Aal::tick() - start) >= slice);
+    }
+
+    /**
+     * Called at the end of a batch of `batch_size` messages that started at
+     * `start`.  In the adaptive mode, updates the average duration of a
+     * message, and the number of messages that fit in the slice.
+     */
+    void end_batch(uint64_t start, size_t batch_size)
+    {
+      if ((mode != Adaptive) || (batch_size == 0))
+        return;
+
+      uint64_t per_message = (snmalloc::Aal::tick() - start) / batch_size;
+      if (per_message > UINT32_MAX)
+        per_message = UINT32_MAX;
+
+      // Exponential moving average with weight 1/4 for the new sample, so
+      // the limit follows changes in behaviour without jumping on outliers.
+      if (average == 0)
+        average = (uint32_t)per_message;
+      else
+        average = (uint32_t)((3 * (uint64_t)average + per_message) / 4);
+
+      uint64_t fit = slice / (average == 0 ? 1 : average);
+      if (fit < 1)
+        fit = 1;
+      if (fit > MAX_ADAPTIVE_COUNT)
+        fit = MAX_ADAPTIVE_COUNT;
+      count = (uint32_t)fit;
+    }
+  };
+} // namespace verona::rt
@@ -8,6 +8,7 @@
 #include "../test/logging.h"
 #include "../test/systematic.h"
 #include "base_noticeboard.h"
+#include "batchlimit.h"
 #include "multimessage.h"
 #include "schedulerthread.h"
 
@@ -25,31 +26,6 @@ namespace verona::rt
     Systematic::yield();
   }
 
-  static Behaviour unmute_behaviour{Behaviour::Descriptor::empty()};
-
-  struct EnqueueLock
-  {
-    std::atomic<bool> locked = false;
-
-    void lock()
-    {
-      auto u = false;
-      while (!locked.compare_exchange_strong(u, true))
-      {
-        u = false;
-        while (locked)
-        {
-          yield();
-        }
-      }
-    }
-
-    void unlock()
-    {
-      locked.store(false, std::memory_order_release);
-    }
-  };
-
   /**
    * A cown, or concurrent owner, encapsulates a set of resources that may be
    * accessed by a single (scheduler) thread at a time. A cown can only be in
@@ -63,6 +39,12 @@ namespace verona::rt
    * future behaviour, or execute the behaviour if it is the last cown to be
    * acquired. If the running cown is acquired for a future behaviour, it will
    * be descheduled until that behaviour has completed.
+   *
+   * A cown whose messages arrive faster than it processes them is overloaded.
+   * A behaviour that sends to an overloaded cown mutes the cowns it ran on:
+   * rather than being rescheduled, they wait on the overloaded cown until it
+   * catches up with its queue.  A muted cown counts as overloaded itself, so
+   * this propagates back through chains of cowns forwarding messages.
    */
   class Cown : public Object
   {
@@ -90,9 +72,7 @@ namespace verona::rt
         if (local != nullptr)
         {
           set_owning_thread(local);
-          next = local->list;
-          local->list = this;
-          local->total_cowns++;
+          local->add_to_list(this);
         }
         else
         {
@@ -114,13 +94,12 @@ namespace verona::rt
 
     static constexpr auto NO_EPOCH_SET = (std::numeric_limits<uint64_t>::max)();
 
-    union
-    {
-      std::atomic<Cown*> next_in_queue;
-      uint64_t epoch_when_popped{NO_EPOCH_SET};
-    };
+    // These are not overlapped, so that a thief walking several elements of
+    // a scheduler queue in `MPMCQ::dequeue_half` only ever reads cown
+    // pointers, even if some of the elements are concurrently popped.
+    std::atomic<Cown*> next_in_queue{nullptr};
+    uint64_t epoch_when_popped{NO_EPOCH_SET};
 
-    // Seven pointer overhead compared to an object.
     verona::rt::MPSCQ<MultiMessage> queue{};
 
     // Used for garbage collection of cyclic cowns only.
@@ -128,7 +107,12 @@ namespace verona::rt
     // If the object is collected by the leak detector, we should not
     // collect again when the weak reference count hits 0.
     std::atomic<uintptr_t> thread_status{0};
+    /// Links in the list of cowns of the owning scheduler thread.
     Cown* next{nullptr};
+    Cown* prev{nullptr};
+    /// Links the cowns whose weak count has reached zero, so that the owning
+    /// thread only visits these to free their stubs.
+    Cown* next_dead{nullptr};
 
     /**
      * Cown's weak reference count.  This keeps the cown itself alive, but not
@@ -137,7 +121,42 @@ namespace verona::rt
      **/
     std::atomic<size_t> weak_count{1};
 
-    EnqueueLock enqueue_lock;
+    /// Limits the messages processed each time this cown runs.
+    BatchLimit batch;
+
+    /// The scheduler queue this cown is scheduled on.
+    std::atomic<Priority> priority{Priority::Normal};
+
+    /// The only scheduler thread that may run this cown, if it is pinned.
+    std::atomic<CownThread*> pinned{nullptr};
+
+    /**
+     * A message whose behaviour has acquired all of its cowns on another
+     * thread, and is waiting to run on the thread this cown is pinned to.
+     * This cown is held by the behaviour, so runs it before its queue.
+     **/
+    std::atomic<MultiMessage*> handed{nullptr};
+
+    /// Number of file descriptors this cown is watching, see `watch_io`.
+    std::atomic<size_t> io_watches{0};
+
+    /**
+     * Number of behaviours holding this cown read-only.  While this is not
+     * zero, a message that writes this cown cannot be processed, and the top
+     * bit is set once the cown stops to wait for the readers to finish.
+     **/
+    std::atomic<size_t> read_count{0};
+    static constexpr size_t READERS_BLOCKED = (size_t)1 << (bits::BITS - 1);
+
+    /**
+     * The cowns muted on this cown, linked through `next_muted`, if this cown
+     * is overloaded, and NOT_OVERLOADED otherwise.  Other threads only push
+     * onto the list while this cown is overloaded, and only the thread
+     * running this cown sets or clears it.
+     **/
+    std::atomic<Cown*> muted{(Cown*)NOT_OVERLOADED};
+    Cown* next_muted{nullptr};
+    static constexpr uintptr_t NOT_OVERLOADED = 1;
 
     static Cown* create_token_cown()
     {
@@ -213,13 +232,93 @@ namespace verona::rt
       }
     }
 
+    /**
+     * Returns true if this cown may be scheduled by an external event source,
+     * which is only while it watches file descriptors, so is treated as a
+     * root by the leak detector.  Pinned cowns are not roots, so are scanned
+     * and collected as other cowns are.
+     */
     bool can_lifo_schedule()
     {
-      // TODO: correctly indicate if this cown can be lifo scheduled.
-      // This requires some form of pinning.
+      return io_watches.load(std::memory_order_relaxed) != 0;
+    }
+
+    /**
+     * Pins this cown to the scheduler thread at position `index` in the ring
+     * of threads, or to the current scheduler thread, so that only that
+     * thread runs it.  Pinned cowns are never stolen by other threads, which
+     * suits cowns that wrap thread-affine resources.  A behaviour on a
+     * pinned cown runs on its thread, unless it also has a cown pinned to a
+     * different thread.
+     *
+     * This must be called before the cown is shared, as cowns are acquired
+     * in an order that depends on whether they are pinned.
+     */
+    void pin(size_t index)
+    {
+      pinned.store(Scheduler::get_thread(index), std::memory_order_release);
+    }
+
+    void pin()
+    {
+      // Must be on a scheduler thread.
+      assert(Scheduler::local() != nullptr);
+      pinned.store(Scheduler::local(), std::memory_order_release);
+    }
+
+    /// Returns the scheduler thread this cown is pinned to, if any.
+    CownThread* get_pinned()
+    {
+      return pinned.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Watches the file descriptor `fd` for the `pal::Poller::Interest`s in
+     * `interest`.  When it becomes ready, this cown is notified, see
+     * `mark_notify`, on the scheduler thread that polled it.  Readiness is
+     * edge triggered, so `fd` should be non-blocking, and the cown's
+     * `notified` should read or write until it would block.
+     *
+     * While watched, `fd` keeps this cown alive and the runtime running.
+     * Returns false if `fd` cannot be watched, including on platforms
+     * without a poller.  Must be called from a scheduler thread.
+     */
+    bool watch_io(int fd, uint32_t interest)
+    {
+      Cown::acquire(this);
+      io_watches.fetch_add(1, std::memory_order_relaxed);
+      Scheduler::add_external_event_source();
+
+      if (Scheduler::io_poller().watch(fd, interest, this))
+        return true;
+
+      Scheduler::remove_external_event_source();
+      io_watches.fetch_sub(1, std::memory_order_relaxed);
+      Cown::release(ThreadAlloc::get(), this);
       return false;
     }
 
+    /**
+     * Stops watching `fd`, which this cown must be watching.  After this,
+     * `fd` no longer causes this cown to be notified, and can be closed.
+     * Must be called from a scheduler thread.
+     */
+    void unwatch_io(int fd)
+    {
+      Scheduler::io_poller().unwatch(fd);
+      Scheduler::remove_external_event_source();
+      io_watches.fetch_sub(1, std::memory_order_relaxed);
+      Cown::release(ThreadAlloc::get(), this);
+    }
+
+    /// Returns true if this cown is pinned to a thread other than the
+    /// current one.
+    bool is_pinned_elsewhere()
+    {
+      auto* p = get_pinned();
+      return (p != nullptr) && (p != Scheduler::local());
+    }
+
     void wake()
     {
       queue.wake();
@@ -310,7 +409,7 @@ namespace verona::rt
           e.add_pressure();
         }
         // Tell owning thread that it has a free cown to collect.
-        t->free_cowns++;
+        t->add_dead(this);
         yield();
       }
     }
@@ -384,6 +483,7 @@ namespace verona::rt
       // TODO Make this assertion pass.
       // assert(can_lifo_schedule() || Scheduler::debug_not_running());
 
+      // A pinned cown is passed on to its own thread.
       t = Scheduler::round_robin();
       t->schedule_lifo(this);
     }
@@ -482,9 +582,20 @@ namespace verona::rt
      * (2) We sent the message to the last cown. There are no further cowns to
      *     acquire, so we schedule the last cown so it can handle the
      *     multi-message behaviour.
-     *     TODO: It would be semantically valid to execute the behaviour without
-     *     rescheduling. However, for fairness, it is better to reschedule in
-     *     case the behaviour executes for a very long time.
+     *
+     * If inline behaviours are enabled, and every cown was acquired here,
+     * then the behaviour is run straight away instead of scheduling the last
+     * cown, see `run_inline`.
+     *
+     * Behaviours that share cowns must be enqueued in a consistent order on
+     * all of those cowns, or each could acquire a cown another is waiting
+     * for.  Rather than locking all the cowns, if our message is placed on a
+     * cown straight after the message of a behaviour that is still
+     * enqueueing, we wait for that behaviour to finish enqueueing before
+     * linking our message and moving on.  As the cowns are sorted, the
+     * behaviour waited on is either further through its cowns or earlier in
+     * the same queue, so the waits cannot form a cycle.  This only waits on
+     * behaviours that share a cown.
      **/
     static void fast_send(MultiMessage::MultiMessageBody* body, EpochMark epoch)
     {
@@ -492,44 +603,46 @@ namespace verona::rt
       const auto last = body->count - 1;
       assert(body->index <= last);
 
-      // First acquire all the locks if a multimessage
-      if (body->count > 1)
-      {
-        for (size_t i = 0; i < body->count; i++)
-        {
-          auto* next = body->cowns[i];
-          Logging::cout() << "Will try to acquire lock " << next
-                          << Logging::endl;
-          next->enqueue_lock.lock();
-          yield();
-          Logging::cout() << "Acquired lock " << next << Logging::endl;
-        }
-      }
-
-      size_t loop_end = body->count;
-      for (size_t i = 0; i < loop_end; i++)
+      bool all_acquired = true;
+      for (size_t i = 0; i < body->count; i++)
       {
-        auto m = MultiMessage::make_message(alloc, body, epoch);
+        auto m = MultiMessage::make_message(body, i, epoch);
         auto* next = body->cowns[i];
         Logging::cout() << "MultiMessage " << m << ": fast requesting " << next
                         << ", index " << i << " behaviour " << body->behaviour
-                        << " loop end " << loop_end << Logging::endl;
+                        << Logging::endl;
 
         auto needs_sched = next->try_fast_send(m);
-        if (loop_end > 1)
-          next->enqueue_lock.unlock();
+        if (i == last)
+          body->enqueued.store(true, std::memory_order_release);
 
         if (!needs_sched)
         {
           Logging::cout() << "try fast send found busy cown " << body
                           << " loop iteration " << i << " cown " << next
                           << Logging::endl;
+          all_acquired = false;
+          continue;
+        }
+
+        if (!m->is_read_only() && next->has_readers())
+        {
+          // The cown is still being read by earlier behaviours, so it must
+          // wait for them before it can process this message.
+          Logging::cout() << "try fast send found read cown " << body
+                          << " loop iteration " << i << " cown " << next
+                          << Logging::endl;
+          next->schedule();
+          all_acquired = false;
           continue;
         }
 
         Logging::cout() << "Will schedule cown " << next << Logging::endl;
         if (i == last)
         {
+          if (all_acquired && next->run_inline(alloc, m))
+            return;
+
           next->schedule();
           return;
         }
@@ -545,14 +658,82 @@ namespace verona::rt
         const auto* m2 = next->queue.dequeue(alloc);
         assert(m == m2);
         UNUSED(m2);
+
+        // A cown acquired read-only is not held until the behaviour runs, so
+        // it is scheduled to process any further messages.
+        if (m->is_read_only())
+        {
+          next->acquire_read();
+          next->schedule();
+        }
       }
     }
 
+    /**
+     * Runs the behaviour of `m` on this thread, rather than scheduling this
+     * cown to run it.  `m` must be the message just sent to this cown, and
+     * all other cowns of the behaviour must already have been acquired.
+     *
+     * This is only done if enabled, on a scheduler thread, and within that
+     * thread's budget for running behaviours inline, as a long chain of
+     * inline behaviours would stop the rest of its queue from running.
+     * Returns false if the behaviour was not run.
+     **/
+    bool run_inline(Alloc& alloc, MultiMessage* m)
+    {
+      auto* t = Scheduler::local();
+      if ((t == nullptr) || !Scheduler::get_inline_behaviours())
+        return false;
+
+      if (is_pinned_elsewhere())
+        return false;
+
+      if (!t->start_inline())
+        return false;
+
+      Logging::cout() << "Run MultiMessage " << m << " inline on " << this
+                      << Logging::endl;
+
+      // As for the other cowns in `fast_send`, we are the first message in
+      // the queue.
+      const auto* m2 = queue.dequeue(alloc);
+      assert(m == m2);
+      UNUSED(m2);
+
+      auto* body = m->get_body();
+
+      // If this cown is read, it is handed back to the scheduler as the
+      // behaviour starts, as no other thread is processing its messages.
+      if (m->is_read_only())
+        acquire_read();
+
+      // This may be nested in a running behaviour, so restore its body, and
+      // the cown it will be muted on.
+      auto* outer = t->message_body;
+      auto* outer_mutor = t->mutor;
+      t->mutor = nullptr;
+      bool completed = run_step(m, true);
+      assert(completed);
+      UNUSED(completed);
+
+      // Schedule all the cowns, as `run` would for the cowns it did not run
+      // on, so their remaining messages are processed.
+      release_cowns(alloc, body, nullptr);
+      t->message_body = outer;
+      t->mutor = outer_mutor;
+
+      t->end_inline();
+      return true;
+    }
+
     /**
      * This method implements an optimized multi-message send to a cown. A
      * sleeping cown will not be reschdeuled because we want to immediately
      * acquire the cown without going through the scheduler queue. Returns true
      * if the cown was asleep and needs scheduling; returns false otherwise.
+     *
+     * The message is not linked behind one from a behaviour that is still
+     * enqueueing, see `fast_send`.
      **/
     bool try_fast_send(MultiMessage* m)
     {
@@ -561,7 +742,10 @@ namespace verona::rt
       yield();
 #endif
       Logging::cout() << "Enqueue MultiMessage " << m << Logging::endl;
-      bool needs_scheduling = queue.enqueue(m);
+      bool needs_scheduling =
+        queue.enqueue(m, [](MultiMessage* prev) {
+          MultiMessage::wait_enqueued(prev);
+        });
       Logging::cout() << "Enqueued MultiMessage " << m << " needs scheduling? "
                       << needs_scheduling << Logging::endl;
       yield();
@@ -581,7 +765,7 @@ namespace verona::rt
      * Otherwise, all cowns have been acquired and we can execute the message
      * behaviour.
      **/
-    bool run_step(MultiMessage* m)
+    bool run_step(MultiMessage* m, bool hand_off)
     {
       MultiMessage::MultiMessageBody& body = *(m->get_body());
       Alloc& alloc = ThreadAlloc::get();
@@ -611,6 +795,30 @@ namespace verona::rt
         return false;
       }
 
+      // A behaviour with a pinned cown runs on its thread.  Pinned cowns are
+      // acquired last, so only the last cown needs checking.
+      auto* last = body.cowns[body.count - 1];
+      if ((last != this) && last->is_pinned_elsewhere())
+      {
+        Logging::cout() << "MultiMessage " << m << " handed to pinned cown "
+                        << last << Logging::endl;
+        last->handed.store(m, std::memory_order_release);
+        last->schedule();
+        return false;
+      }
+
+      return run_acquired(m, hand_off);
+    }
+
+    /**
+     * Runs the behaviour of `m`, once all of its cowns have been acquired.
+     **/
+    bool run_acquired(MultiMessage* m, bool hand_off)
+    {
+      MultiMessage::MultiMessageBody& body = *(m->get_body());
+      Alloc& alloc = ThreadAlloc::get();
+      EpochMark e = m->get_epoch();
+
       if (e == EpochMark::EPOCH_NONE)
       {
         // decrement counter as it must have been incremented earlier for the
@@ -645,27 +853,230 @@ namespace verona::rt
         }
       }
 
+      // A cown that is only read can carry on with its other messages on
+      // another thread while the behaviour runs.
+      if (hand_off && m->is_read_only())
+      {
+        Logging::cout() << "Hand off read cown " << this << Logging::endl;
+        schedule();
+      }
+
       Scheduler::local()->message_body = &body;
 
       // Run the behaviour.
       body.behaviour->f();
 
-      for (size_t i = 0; i < body.count; i++)
+      Logging::cout() << "MultiMessage " << m << " completed and running on "
+                      << this << Logging::endl;
+
+      return true;
+    }
+
+    /**
+     * Releases the cowns of a behaviour that has run, and frees its body.
+     * The cowns it held exclusively are scheduled so they process their
+     * remaining messages, except `running`, which is the cown whose batch
+     * ran the behaviour.
+     *
+     * If the behaviour sent to an overloaded cown, then the cowns it held
+     * exclusively are muted instead.  Returns true if `running` was muted, so
+     * must stop processing messages.
+     **/
+    static bool release_cowns(
+      Alloc& alloc, MultiMessage::MultiMessageBody* body, Cown* running)
+    {
+      auto* t = Scheduler::local();
+      Cown* mutor = nullptr;
+      if (t != nullptr)
       {
-        if (body.cowns[i])
-          Cown::release(alloc, body.cowns[i]);
+        mutor = t->mutor;
+        t->mutor = nullptr;
       }
 
-      Logging::cout() << "MultiMessage " << m << " completed and running on "
-                      << this << Logging::endl;
+      bool running_muted = false;
+      for (size_t s = 0; s < body->count; s++)
+      {
+        auto* c = body->cowns[s];
+        if (c == nullptr)
+          continue;
+
+        if (MultiMessage::is_read_only(body, s))
+        {
+          // Must come before dropping the reference, as this may be the last
+          // reference keeping the cown alive.
+          c->release_read();
+          Cown::release(alloc, c);
+        }
+        else
+        {
+          Cown::release(alloc, c);
+          if ((mutor != nullptr) && c->mute(mutor))
+          {
+            t->stats.mute();
+            running_muted |= (c == running);
+          }
+          else if (c != running)
+          {
+            c->schedule();
+          }
+        }
+      }
 
-      // Free the body and the behaviour.
-      alloc.dealloc(body.behaviour, body.behaviour->size());
-      alloc.dealloc<sizeof(MultiMessage::MultiMessageBody)>(m->get_body());
+      if (mutor != nullptr)
+        Cown::release(alloc, mutor);
+
+      MultiMessage::release_body(alloc, body);
+      return running_muted;
+    }
+
+    bool is_overloaded()
+    {
+      return (uintptr_t)muted.load(std::memory_order_acquire) != NOT_OVERLOADED;
+    }
 
+    /// Called by the thread running this cown when it has fallen behind its
+    /// queue.
+    void set_overloaded()
+    {
+      if (is_overloaded())
+        return;
+
+      Logging::cout() << "Cown " << this << " is overloaded" << Logging::endl;
+      muted.store(nullptr, std::memory_order_release);
+      yield();
+    }
+
+    /**
+     * Called by the thread running this cown when it has caught up with its
+     * queue, or cannot make progress on it for now.  Reschedules the cowns
+     * muted on this cown.
+     **/
+    void clear_overloaded()
+    {
+      if (!is_overloaded())
+        return;
+
+      yield();
+      auto* c =
+        muted.exchange((Cown*)NOT_OVERLOADED, std::memory_order_acq_rel);
+      Logging::cout() << "Cown " << this << " is no longer overloaded"
+                      << Logging::endl;
+      while (c != nullptr)
+      {
+        // Read the link first, as the cown may be muted again once it is
+        // scheduled.
+        auto* next = c->next_muted;
+        Logging::cout() << "Unmute cown " << c << Logging::endl;
+        c->schedule();
+        c = next;
+      }
+    }
+
+    /**
+     * Mutes this cown on `mutor`, which is held by the calling thread after
+     * running a behaviour on it.  Fails if `mutor` is no longer overloaded,
+     * or if this cown is overloaded, as muting it would stop it from
+     * catching up.  This also prevents cycles of muted cowns.
+     *
+     * A muted cown is overloaded, so any cowns that send to it are muted on
+     * it in turn.
+     **/
+    bool mute(Cown* mutor)
+    {
+      if ((mutor == this) || is_overloaded())
+        return false;
+
+      // Must be overloaded before it can be scheduled by the mutor.
+      set_overloaded();
+
+      auto* head = mutor->muted.load(std::memory_order_acquire);
+      do
+      {
+        if ((uintptr_t)head == NOT_OVERLOADED)
+        {
+          // Unmutes any cowns that were muted on this cown in the meantime.
+          clear_overloaded();
+          return false;
+        }
+        next_muted = head;
+      } while (!mutor->muted.compare_exchange_weak(
+        head, this, std::memory_order_acq_rel));
+
+      Logging::cout() << "Cown " << this << " muted on " << mutor
+                      << Logging::endl;
+      yield();
       return true;
     }
 
+    /**
+     * Called when a behaviour running on this thread sends to `cown`.  If
+     * `cown` is overloaded, it is recorded so the cowns of the behaviour are
+     * muted on it when it completes.
+     **/
+    static void check_overloaded(Cown* cown)
+    {
+      auto* t = Scheduler::local();
+      if (
+        (t == nullptr) || (t->message_body == nullptr) ||
+        (t->mutor != nullptr) || !cown->is_overloaded())
+        return;
+
+      Logging::cout() << "Sent to overloaded cown " << cown << Logging::endl;
+      Cown::acquire(cown);
+      t->mutor = cown;
+    }
+
+    bool has_readers()
+    {
+      return read_count.load(std::memory_order_acquire) != 0;
+    }
+
+    /// Called by the thread processing this cown's messages when it acquires
+    /// this cown read-only for a behaviour.
+    void acquire_read()
+    {
+      read_count.fetch_add(1, std::memory_order_acq_rel);
+      yield();
+    }
+
+    /**
+     * Called by the thread processing this cown's messages before a message
+     * that writes this cown.  Returns true if there are readers, in which
+     * case this cown must stop, and is scheduled again by the last reader.
+     **/
+    bool wait_for_readers()
+    {
+      size_t r = read_count.load(std::memory_order_acquire);
+      while (r != 0)
+      {
+        assert((r & READERS_BLOCKED) == 0);
+        if (read_count.compare_exchange_weak(
+              r, r | READERS_BLOCKED, std::memory_order_acq_rel))
+        {
+          Logging::cout() << "Cown " << this << " waiting for " << r
+                          << " readers" << Logging::endl;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// Called when a behaviour that held this cown read-only has run.
+    void release_read()
+    {
+      yield();
+      auto r = read_count.fetch_sub(1, std::memory_order_acq_rel);
+      assert((r & ~READERS_BLOCKED) != 0);
+      if (r == (READERS_BLOCKED | 1))
+      {
+        // The cown stopped for the readers, and this was the last.  No other
+        // thread can change the count until it is scheduled again.
+        read_count.store(0, std::memory_order_release);
+        Logging::cout() << "Last reader reschedules " << this << Logging::endl;
+        schedule();
+      }
+    }
+
   public:
     template<
       class Behaviour,
@@ -673,7 +1084,7 @@ namespace verona::rt
       typename... Args>
     static void schedule(Cown* cown, Args&&... args)
     {
-      schedule<Behaviour, transfer, Args...>(
+      schedule_body<Behaviour, transfer, 1>(
         1, &cown, std::forward<Args>(args)...);
     }
 
@@ -689,24 +1100,102 @@ namespace verona::rt
       TransferOwnership transfer = NoTransfer,
       typename... Args>
     static void schedule(size_t count, Cown** cowns, Args&&... args)
+    {
+      schedule_body<Be, transfer, 0>(
+        count, cowns, std::forward<Args>(args)...);
+    }
+
+    /**
+     * As above, for a number of cowns known at compile time, so the message
+     * allocation has a fixed size.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      size_t Count,
+      typename... Args>
+    static void schedule(Cown* (&cowns)[Count], Args&&... args)
+    {
+      schedule_body<Be, transfer, Count>(
+        Count, cowns, std::forward<Args>(args)...);
+    }
+
+    /**
+     * As above, but each cown is requested either exclusively or read-only,
+     * see `Request`.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      typename... Args>
+    static void schedule(size_t count, Request* requests, Args&&... args)
+    {
+      schedule_body<Be, transfer, 0>(
+        count, requests, std::forward<Args>(args)...);
+    }
+
+    template<
+      class Be,
+      TransferOwnership transfer = NoTransfer,
+      size_t Count,
+      typename... Args>
+    static void schedule(Request (&requests)[Count], Args&&... args)
+    {
+      schedule_body<Be, transfer, Count>(
+        Count, requests, std::forward<Args>(args)...);
+    }
+
+  private:
+    /**
+     * Allocates the behaviour, together with the body and messages used to
+     * acquire its cowns, and sends it.  `Count` is either `count`, or zero if
+     * the number of cowns is not known at compile time.
+     **/
+    template<
+      class Be,
+      TransferOwnership transfer,
+      size_t Count,
+      typename Src,
+      typename... Args>
+    static void schedule_body(size_t count, Src* cowns, Args&&... args)
     {
       static_assert(std::is_base_of_v<Behaviour, Be>);
       Logging::cout() << "Schedule behaviour of type: " << typeid(Be).name()
                       << Logging::endl;
 
       auto& alloc = ThreadAlloc::get();
-      auto* be =
-        new ((Be*)alloc.alloc<sizeof(Be)>()) Be(std::forward<Args>(args)...);
-      auto** sort = (Cown**)alloc.alloc(count * sizeof(Cown*));
-      memcpy(sort, cowns, count * sizeof(Cown*));
+      auto* body = MultiMessage::make_body<Be, Count>(
+        alloc, count, cowns, std::forward<Args>(args)...);
+      auto** sort = body->cowns;
 
-#ifdef USE_SYSTEMATIC_TESTING
+      // Requests are sorted with their read-only tags.  Pinned cowns are
+      // acquired last, so the behaviour runs on the thread of a pinned cown.
       std::sort(&sort[0], &sort[count], [](Cown*& a, Cown*& b) {
-        return a->id() < b->id();
-      });
+        auto* ua = MultiMessage::untagged(a);
+        auto* ub = MultiMessage::untagged(b);
+        bool pa = ua->get_pinned() != nullptr;
+        bool pb = ub->get_pinned() != nullptr;
+        if (pa != pb)
+          return pb;
+#ifdef USE_SYSTEMATIC_TESTING
+        return ua->id() < ub->id();
 #else
-      std::sort(&sort[0], &sort[count]);
+        return ua < ub;
 #endif
+      });
+
+      if constexpr (std::is_same_v<Src, Request>)
+      {
+        MultiMessage::untag_read_only(body);
+
+        // The behaviour is handed to its last cown if that is pinned, which
+        // relies on the cown being held exclusively.
+        if (sort[count - 1]->get_pinned() != nullptr)
+          MultiMessage::get_message(body, count - 1)->read_only = false;
+      }
+
+      for (size_t i = 0; i < count; i++)
+        check_overloaded(sort[i]);
 
       if constexpr (transfer == NoTransfer)
       {
@@ -714,14 +1203,12 @@ namespace verona::rt
           Cown::acquire(sort[i]);
       }
 
-      auto body = MultiMessage::make_body(alloc, count, sort, be);
-
-      // TODO what if this thread is external.
-      //  EPOCH_A okay as currently only sending externally, before we start
-      //  and thus its okay.
-      //  Need to use another value when we add pinned cowns.
+      // A thread outside the runtime, such as one sending to a pinned cown,
+      // may send while the leak detector is running, so its messages are
+      // counted as inflight until they are received.
       auto sched = Scheduler::local();
-      auto epoch = sched == nullptr ? EpochMark::EPOCH_A : Scheduler::epoch();
+      auto epoch =
+        (sched == nullptr) ? EpochMark::EPOCH_NONE : Scheduler::epoch();
 
       if (epoch == EpochMark::EPOCH_NONE)
       {
@@ -733,6 +1220,7 @@ namespace verona::rt
       fast_send(body, epoch);
     }
 
+  public:
     /**
      * This processes a batch of messages on a cown.
      *
@@ -749,21 +1237,90 @@ namespace verona::rt
      * called, and it is guaranteed to return true, so it will be rescheduled
      * or false if it is part of a multi-message acquire.
      **/
-    bool run(Alloc& alloc, ThreadState::State)
+    bool run(Alloc& alloc, ThreadState::State state)
+    {
+      size_t batch_size = 0;
+      bool hit_limit = false;
+      bool reschedule = run_batch(alloc, state, batch_size, hit_limit);
+      // This cown may have been deallocated, so only the size is recorded.
+      Scheduler::local()->stats.batch(batch_size, hit_limit);
+      return reschedule;
+    }
+
+    /**
+     * Sets how many messages this cown processes each time it runs.  This
+     * should only be called by the cown's behaviours, or before the cown is
+     * shared.
+     */
+    void set_batch_limit(BatchLimit limit)
+    {
+      batch = limit;
+    }
+
+    /**
+     * Sets the priority with which this cown is scheduled.  High priority
+     * cowns are run ahead of normal priority cowns, so this suits cowns whose
+     * behaviours are short and latency sensitive.  Takes effect the next
+     * time the cown is scheduled.
+     */
+    void set_priority(Priority p)
+    {
+      priority.store(p, std::memory_order_relaxed);
+    }
+
+    Priority get_priority()
+    {
+      return priority.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /**
+     * Process messages on this cown, up to its batch limit.  The number of
+     * messages processed is added to `batch_size`, and `hit_limit` is set if
+     * the batch stopped because of the limit.  Returns true if the cown
+     * should be rescheduled.
+     */
+    bool run_batch(
+      Alloc& alloc, ThreadState::State, size_t& batch_size, bool& hit_limit)
     {
       auto until = queue.peek_back();
       yield(); // Reading global state in peek_back().
 
-      static constexpr size_t batch_limit = 100;
+      const size_t max_messages = batch.max_messages();
+      const uint64_t start = batch.is_timed() ? Aal::tick() : 0;
+
       auto notified_called = false;
       auto notify = false;
 
+      // Run a behaviour handed to this cown, see `run_step`.
+      auto* h = handed.exchange(nullptr, std::memory_order_acquire);
+      if (h != nullptr)
+      {
+        batch_size++;
+        auto* body = h->get_body();
+        run_acquired(h, false);
+        if (release_cowns(alloc, body, this))
+          return false;
+      }
+
       MultiMessage* curr = nullptr;
-      size_t batch_size = 0;
       do
       {
         assert(!queue.is_sleeping());
 
+        // A message that writes this cown must wait for its readers.
+        if (has_readers())
+        {
+          auto* next = queue.peek();
+          if ((next != nullptr) && !next->is_read_only())
+          {
+            // Once this cown waits, it may be rescheduled on another thread.
+            clear_overloaded();
+            if (wait_for_readers())
+              return false;
+          }
+        }
+
         curr = queue.dequeue(alloc, notify);
 
         if (!notified_called && notify)
@@ -774,6 +1331,9 @@ namespace verona::rt
 
         if (curr == nullptr)
         {
+          batch.end_batch(start, batch_size);
+          clear_overloaded();
+
           if (Scheduler::should_scan())
           {
             // We have hit null, and we should scan, then we know
@@ -833,29 +1393,63 @@ namespace verona::rt
         Logging::cout() << "Running Message " << curr << " on cown " << this
                         << Logging::endl;
 
-        auto* senders = body->cowns;
-        const size_t senders_count = body->count;
+        // If this cown is only read, then it carries on processing messages
+        // while the behaviour waits for its other cowns, or hands off its
+        // remaining messages to another thread if the behaviour runs here.
+        bool read_only = curr->is_read_only();
+        bool hand_off = false;
+        if (read_only)
+        {
+          acquire_read();
+          hand_off = queue.peek() != nullptr;
+        }
+
+        // A cown that is held by a behaviour waiting for its other cowns
+        // does not process its queue, so should not keep its senders muted.
+        // This must be done before it can be rescheduled on another thread.
+        if (!read_only && (body->exec_count_down.load() > 1))
+          clear_overloaded();
 
         // A function that returns false indicates that the cown should not
         // be rescheduled, even if it has pending work. This also means the
         // cown's queue should not be marked as empty, even if it is.
-        if (!run_step(curr))
-          return false;
+        if (!run_step(curr, hand_off))
+        {
+          if (!read_only)
+            return false;
+        }
+        else
+        {
+          // Reschedule the other cowns.  If this cown was muted, then it is
+          // now waiting on another cown.
+          if (release_cowns(alloc, body, this))
+            return false;
+
+          // Another thread may now be running this cown.
+          if (hand_off)
+            return false;
+        }
 
-        // Reschedule the other cowns.
-        for (size_t s = 0; s < senders_count; s++)
+        if ((batch_size >= max_messages) || batch.slice_used(start))
         {
-          if ((senders[s]) && (senders[s] != this))
-            senders[s]->schedule();
+          hit_limit = curr != until;
+          break;
         }
+      } while (curr != until);
 
-        alloc.dealloc(senders, senders_count * sizeof(Cown*));
+      batch.end_batch(start, batch_size);
 
-      } while ((curr != until) && (batch_size < batch_limit));
+      // Leak detection needs every cown to be scanned, so does not leave any
+      // muted.
+      if (hit_limit && !Scheduler::should_scan())
+        set_overloaded();
+      else
+        clear_overloaded();
 
       return true;
     }
 
+  public:
     bool try_collect(Alloc& alloc, EpochMark epoch)
     {
       Logging::cout() << "try_collect: " << this << " (" << get_epoch_mark()
@@ -986,7 +1580,7 @@ namespace verona::rt
       // All messages must have been run by the time the cown is collected.
       assert(stub->next.load(std::memory_order_relaxed) == nullptr);
 
-      alloc.dealloc<sizeof(MultiMessage)>(stub);
+      stub->dealloc(alloc);
     }
 
     bool release_early()
@@ -1007,8 +1601,16 @@ namespace verona::rt
       {
         if (senders[s] != this)
           continue;
-        Cown::release(alloc, senders[s]);
-        senders[s]->schedule();
+        if (MultiMessage::is_read_only(body, s))
+        {
+          release_read();
+          Cown::release(alloc, senders[s]);
+        }
+        else
+        {
+          Cown::release(alloc, senders[s]);
+          senders[s]->schedule();
+        }
         senders[s] = nullptr;
         break;
       }
@@ -1021,20 +1623,7 @@ namespace verona::rt
      */
     static MultiMessage* stub_msg(Alloc& alloc)
     {
-      return MultiMessage::make_message(alloc, nullptr, EpochMark::EPOCH_NONE);
-    }
-
-    /**
-     * Create an unmute message using an empty behaviour. The given array of
-     * cowns may be null terminated, but the count must always be count of
-     * pointers that indicates the size of the allocation.
-     */
-    static MultiMessage*
-    unmute_msg(Alloc& alloc, size_t count, Cown** cowns, EpochMark epoch)
-    {
-      auto* body =
-        MultiMessage::make_body(alloc, count, cowns, &unmute_behaviour);
-      return MultiMessage::make_message(alloc, body, epoch);
+      return MultiMessage::make_stub(alloc);
     }
   };
 
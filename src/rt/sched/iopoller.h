@@ -0,0 +1,159 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "../pal/poller.h"
+#include "test/logging.h"
+#include "test/systematic.h"
+
+#include <atomic>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * The file descriptors watched by cowns, shared by all scheduler threads.
+   *
+   * Scheduler threads poll for readiness without blocking when they are
+   * about to park, and when they reach their token cown, so busy threads
+   * still pick up I/O.  Only one thread polls at a time, and other threads
+   * skip polling rather than wait for it.  Once every other thread is
+   * paused, the last thread blocks polling instead of parking, and is woken
+   * through the poller by an unpause.
+   *
+   * The data of each watch is the cown to notify, see `Cown::watch_io`.
+   */
+  class IOPoller
+  {
+    pal::Poller poller;
+
+    /// Held while polling, so a watch is not removed while the thread
+    /// polling may hold its data.
+    std::atomic<bool> busy{false};
+
+    /// Number of watched file descriptors.
+    std::atomic<size_t> watches{0};
+
+    /// Set while a thread may be blocked polling.
+    std::atomic<bool> waiting{false};
+
+    bool try_lock()
+    {
+      return !busy.exchange(true, std::memory_order_acquire);
+    }
+
+    void lock()
+    {
+      while (!try_lock())
+      {
+        // The thread holding the lock may be blocked polling.
+        wake_waiter();
+        snmalloc::Aal::pause();
+        Systematic::yield();
+      }
+    }
+
+    void unlock()
+    {
+      busy.store(false, std::memory_order_release);
+    }
+
+  public:
+    static constexpr bool supported = pal::Poller::supported;
+
+    constexpr IOPoller() = default;
+
+    bool has_watches()
+    {
+      return watches.load(std::memory_order_acquire) != 0;
+    }
+
+    /// Starts watching `fd` for the `pal::Poller::Interest`s in `interest`.
+    /// Returns false if it cannot be watched.
+    bool watch(int fd, uint32_t interest, void* data)
+    {
+      lock();
+      bool ok = (poller.is_open() || poller.open()) &&
+        poller.add(fd, interest, data);
+      if (ok)
+        watches.fetch_add(1, std::memory_order_release);
+      unlock();
+
+      Logging::cout() << "Watch fd " << fd << " for " << data << ": " << ok
+                      << Logging::endl;
+      return ok;
+    }
+
+    /// Stops watching `fd`.  Once this returns, its data will not be passed
+    /// to a `poll` callback.
+    void unwatch(int fd)
+    {
+      lock();
+      poller.remove(fd);
+      watches.fetch_sub(1, std::memory_order_release);
+      unlock();
+
+      Logging::cout() << "Unwatch fd " << fd << Logging::endl;
+    }
+
+    /**
+     * Calls `f` with the data of each watched descriptor that has become
+     * ready.  Waits for up to `timeout_ms` milliseconds, or forever if it is
+     * -1, until one is ready or `wake_waiter` is called.  A thread may wait
+     * when nothing is watched, such as for a timer, once it has called
+     * `open`.  Returns immediately if another thread is polling.  Returns
+     * true if any descriptor was ready.
+     */
+    template<typename F>
+    bool poll(int timeout_ms, F&& f)
+    {
+      if (((timeout_ms == 0) && !has_watches()) || !try_lock())
+        return false;
+
+      size_t ready = 0;
+      if (poller.is_open())
+        ready = poller.wait(timeout_ms, f);
+      unlock();
+      return ready != 0;
+    }
+
+    /**
+     * Opens the poller if it is not already open.  This must be done before
+     * `set_waiting`, so that `wake_waiter` reaches the thread.  Returns false
+     * on platforms without a poller.
+     */
+    bool open()
+    {
+      lock();
+      bool ok = poller.is_open() || poller.open();
+      unlock();
+      return ok;
+    }
+
+    /**
+     * Sets whether a thread is about to block polling.  This must be set
+     * before that thread last checks for a racing unpause, and an unpause
+     * must call `wake_waiter` after publishing itself.
+     */
+    void set_waiting(bool w)
+    {
+      waiting.store(w, std::memory_order_seq_cst);
+    }
+
+    /// Wakes the thread blocked polling, if there may be one.
+    void wake_waiter()
+    {
+      if (waiting.load(std::memory_order_seq_cst))
+        poller.wake();
+    }
+
+    /// Releases the poller.  Called at teardown, when nothing is watched.
+    /// A later `watch` or `poll` opens it again.
+    void close()
+    {
+      assert(!has_watches());
+      if (poller.is_open())
+        poller.close();
+    }
+  };
+} // namespace verona::rt
@@ -90,18 +90,28 @@ namespace verona::rt
      * completed.
      */
     void enqueue(Alloc& alloc, T* node)
+    {
+      enqueue_segment(alloc, node, node);
+    }
+
+    /**
+     * Enqueue a segment of nodes already linked through `next_in_queue`,
+     * from `first` to `last` inclusive.  The whole segment is added with a
+     * single exchange on `back`.  Has the same linearisability as `enqueue`.
+     */
+    void enqueue_segment(Alloc& alloc, T* first, T* last)
     {
       UNUSED(alloc);
-      auto unmasked_node = unmask(node);
-      unmasked_node->next_in_queue = nullptr;
+      auto unmasked_last = unmask(last);
+      unmasked_last->next_in_queue = nullptr;
       std::atomic_thread_fence(std::memory_order_release);
       auto unmasked_back =
-        unmask(back.exchange(node, std::memory_order_relaxed));
+        unmask(back.exchange(last, std::memory_order_relaxed));
       // The element we are writing into must have made its next pointer null
       // before exchanging into the structure, as the element cannot be removed
       // if it has a null next pointer, we know the write is safe.
       assert(unmasked_back->next_in_queue == nullptr);
-      unmasked_back->next_in_queue.store(node, std::memory_order_relaxed);
+      unmasked_back->next_in_queue.store(first, std::memory_order_relaxed);
     }
 
     void enqueue_front(Alloc& alloc, T* node)
@@ -158,6 +168,131 @@ namespace verona::rt
       return fnt;
     }
 
+    /**
+     * Take up to half of the elements currently visible in the queue, but no
+     * more than `max`, using a single compare and swap on `front`.
+     *
+     * The first element is returned as for `dequeue`.  Any further elements
+     * are returned as a segment from `rest_first` to `rest_last`, still
+     * linked through `next_in_queue`, which the caller must pass to
+     * `enqueue_segment` on some queue.  If only one element is taken, then
+     * `rest_first` is nullptr.  Tokens are never taken as part of the
+     * segment, so a token is only ever taken on its own.
+     *
+     * This may spuriously fail in the same way as `dequeue`.
+     */
+    T* dequeue_half(Alloc& alloc, size_t max, T*& rest_first, T*& rest_last)
+    {
+      assert(max > 0);
+      T* fnt;
+      T* last;
+      T* next;
+
+      // Hold epoch to ensure that the elements read from the queue cannot be
+      // deallocated during this operation.  This must occur before read of
+      // front.
+      Epoch e(alloc);
+      uint64_t epoch = e.get_local_epoch_epoch();
+
+      auto cmp = front.read();
+      do
+      {
+        fnt = cmp.ptr();
+        // This operation is memory safe due to holding the epoch.
+        next = unmask(fnt)->next_in_queue;
+
+        // See `dequeue` for why this can spuriously be nullptr.
+        if (next == nullptr)
+          return nullptr;
+
+        // Count the elements that could be taken after the first.  An element
+        // can only be taken if it has a successor, as the new front must be
+        // non-null.  Stop at a token, so it stays with its queue.  The chain
+        // is only read, so this is safe for the same reason as above, and
+        // the compare and swap fails if any of it has been dequeued since.
+        size_t available = 1;
+        if (!is_bit_set(fnt))
+        {
+          T* curr = next;
+          while ((available < 2 * max) && !is_bit_set(curr))
+          {
+            T* curr_next = curr->next_in_queue;
+            if (curr_next == nullptr)
+              break;
+            available++;
+            curr = curr_next;
+          }
+        }
+
+        // Take half of what is available, rounding up so that a single
+        // element is taken as with `dequeue`.
+        size_t count = (available + 1) / 2;
+        if (count > max)
+          count = max;
+
+        last = fnt;
+        next = unmask(fnt)->next_in_queue;
+        for (size_t i = 1; i < count; i++)
+        {
+          // Elements may have been dequeued and rescheduled while walking the
+          // chain, so the second read may differ from the first.  The compare
+          // and swap would fail, so treat this as a spurious failure.
+          if ((next == nullptr) || is_bit_set(next))
+            return nullptr;
+          last = next;
+          next = next->next_in_queue;
+        }
+
+        if (next == nullptr)
+          return nullptr;
+      } while (!cmp.store_conditional(next));
+
+      assert(epoch != T::NO_EPOCH_SET);
+
+      if (last == fnt)
+      {
+        rest_first = nullptr;
+        rest_last = nullptr;
+      }
+      else
+      {
+        rest_first = unmask(fnt)->next_in_queue;
+        rest_last = last;
+      }
+
+      // Only the first element leaves the queues.  The rest are moved to the
+      // caller's queue, and will record the epoch when they are popped from
+      // there.
+      unmask(fnt)->epoch_when_popped = epoch;
+
+      return fnt;
+    }
+
+    /**
+     * Counts the elements in the queue, other than tokens, stopping at
+     * `limit`.  The queue may be modified concurrently, so this is only
+     * approximate.
+     */
+    size_t approximate_length(Alloc& alloc, size_t limit)
+    {
+      // Hold epoch to ensure that the elements read from the queue cannot be
+      // deallocated during this operation.
+      Epoch e(alloc);
+
+      size_t count = 0;
+      // Bound the number of steps, as elements may be concurrently moved to
+      // other queues, so the walk may not end at this queue's back.
+      T* curr = front.peek();
+      for (size_t i = 0; (curr != nullptr) && (i < limit); i++)
+      {
+        if (!is_bit_set(curr))
+          count++;
+        curr = unmask(curr)->next_in_queue;
+      }
+
+      return count;
+    }
+
     // The callers are expected to guarantee no one is attempting to access the
     // queue concurrently.
     void destroy(Alloc& alloc)
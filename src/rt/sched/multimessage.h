@@ -12,6 +12,56 @@ namespace verona::rt
 {
   using namespace snmalloc;
 
+  /**
+   * A cown for a behaviour to acquire, and whether the behaviour only reads
+   * it.  Any number of behaviours that only read a cown can hold it at the
+   * same time.
+   **/
+  class Request
+  {
+    Cown* _cown;
+    bool _read_only;
+
+    Request(Cown* cown, bool read_only) : _cown(cown), _read_only(read_only)
+    {}
+
+  public:
+    /// Acquire `cown` exclusively.
+    static Request write(Cown* cown)
+    {
+      return {cown, false};
+    }
+
+    /// Acquire `cown` shared with other readers.
+    static Request read(Cown* cown)
+    {
+      return {cown, true};
+    }
+
+    Cown* cown() const
+    {
+      return _cown;
+    }
+
+    bool is_read_only() const
+    {
+      return _read_only;
+    }
+  };
+
+  /**
+   * A message sent to each cown that a behaviour needs to acquire.
+   *
+   * The behaviour, its body, the array of cowns and the messages for those
+   * cowns are all held in one allocation, laid out as
+   *
+   *   [ Behaviour | MultiMessageBody | Cown* x count | MultiMessage x count ]
+   *
+   * A message stays in a cown's queue as its stub after it is dequeued, so
+   * the allocation is reference counted: once for each message, which is
+   * released when the queue frees the message, and once for running the
+   * behaviour.
+   **/
   class MultiMessage
   {
     struct MultiMessageBody
@@ -21,6 +71,12 @@ namespace verona::rt
       Cown** cowns;
       std::atomic<size_t> exec_count_down;
       Behaviour* behaviour;
+      /// References to the allocation holding this body.
+      std::atomic<size_t> references;
+      /// Size of the allocation holding this body.
+      size_t size;
+      /// Set once the messages have been enqueued on all the cowns.
+      std::atomic<bool> enqueued;
     };
 
   private:
@@ -30,20 +86,46 @@ namespace verona::rt
 
     std::atomic<MultiMessage*> next{nullptr};
 
+    /// True if this message acquires its cown read-only.
+    bool read_only;
+
+    /// Marks a cown in the body's array as requested read-only, until the
+    /// array is sorted.
+    static constexpr uintptr_t READ_ONLY_TAG = 1;
+
     inline MultiMessageBody* get_body()
     {
       return (MultiMessageBody*)((uintptr_t)body & ~Object::MARK_MASK);
     }
 
     static MultiMessage*
-    make(Alloc& alloc, EpochMark epoch, MultiMessageBody* body)
+    make(void* p, EpochMark epoch, MultiMessageBody* body)
     {
-      auto msg = (MultiMessage*)alloc.alloc<sizeof(MultiMessage)>();
+      auto msg = (MultiMessage*)p;
       msg->body = body;
       msg->set_epoch(epoch);
       return msg;
     }
 
+    /// Offset of the body from the start of the allocation.
+    static constexpr size_t body_offset(size_t behaviour_size)
+    {
+      return bits::align_up(behaviour_size, alignof(MultiMessageBody));
+    }
+
+    /// Size of the allocation for a behaviour of `behaviour_size` bytes on
+    /// `count` cowns.
+    static constexpr size_t alloc_size(size_t behaviour_size, size_t count)
+    {
+      return body_offset(behaviour_size) + sizeof(MultiMessageBody) +
+        count * (sizeof(Cown*) + sizeof(MultiMessage));
+    }
+
+    inline bool is_read_only()
+    {
+      return read_only;
+    }
+
     inline bool in_epoch(EpochMark e)
     {
       return get_epoch() == e;
@@ -68,25 +150,156 @@ namespace verona::rt
       assert(get_epoch() == e);
     }
 
+    /**
+     * Allocates the body of a behaviour of type `Be` on `count` cowns,
+     * copying the cowns from `cowns`, which holds either `Cown*`s or
+     * `Request`s.  If `Count` is not zero, it must equal
+     * `count`, and the size of the allocation is computed at compile time.
+     **/
+    template<class Be, size_t Count = 0, typename Src, typename... Args>
     static MultiMessageBody*
-    make_body(Alloc& alloc, size_t count, Cown** cowns, Behaviour* behaviour)
+    make_body(Alloc& alloc, size_t count, Src* cowns, Args&&... args)
     {
-      return new (alloc.alloc<sizeof(MultiMessageBody)>())
-        MultiMessageBody{0, count, cowns, count, behaviour};
+      static_assert(alignof(MultiMessageBody) > Object::MARK_MASK);
+      assert((Count == 0) || (Count == count));
+
+      void* p;
+      size_t size;
+      if constexpr (Count == 0)
+      {
+        size = alloc_size(sizeof(Be), count);
+        p = alloc.alloc(size);
+      }
+      else
+      {
+        size = alloc_size(sizeof(Be), Count);
+        p = alloc.alloc<alloc_size(sizeof(Be), Count)>();
+      }
+
+      auto* be = new ((Be*)p) Be(std::forward<Args>(args)...);
+      auto* body = pointer_offset<MultiMessageBody>(p, body_offset(sizeof(Be)));
+      auto** body_cowns = pointer_offset<Cown*>(body, sizeof(MultiMessageBody));
+      for (size_t i = 0; i < count; i++)
+      {
+        if constexpr (std::is_same_v<Src, Request>)
+        {
+          auto tag = cowns[i].is_read_only() ? READ_ONLY_TAG : 0;
+          body_cowns[i] = (Cown*)((uintptr_t)cowns[i].cown() | tag);
+        }
+        else
+        {
+          body_cowns[i] = cowns[i];
+        }
+      }
+
+      body = new (body) MultiMessageBody{
+        0, count, body_cowns, count, be, count + 1, size, false};
+      for (size_t i = 0; i < count; i++)
+        get_message(body, i)->read_only = false;
+      return body;
+    }
+
+    /**
+     * For a body made from an array of `Request`s, the cowns requested
+     * read-only are tagged in the array of cowns, so the tags move with the
+     * cowns when they are sorted.  This moves the tags onto the messages.
+     **/
+    static void untag_read_only(MultiMessageBody* body)
+    {
+      for (size_t i = 0; i < body->count; i++)
+      {
+        auto c = (uintptr_t)body->cowns[i];
+        get_message(body, i)->read_only = (c & READ_ONLY_TAG) != 0;
+        body->cowns[i] = (Cown*)(c & ~READ_ONLY_TAG);
+      }
+    }
+
+    /// Removes the read-only tag, if any, from an entry in the array of cowns.
+    static Cown* untagged(Cown* c)
+    {
+      return (Cown*)((uintptr_t)c & ~READ_ONLY_TAG);
     }
 
+    /**
+     * Drops a reference to the allocation holding `body`, freeing it if this
+     * was the last.
+     **/
+    static void release_body(Alloc& alloc, MultiMessageBody* body)
+    {
+      if (body->references.fetch_sub(1, std::memory_order_acq_rel) > 1)
+        return;
+
+      Logging::cout() << "MultiMessage body " << body << " freed"
+                      << Logging::endl;
+      alloc.dealloc(body->behaviour, body->size);
+    }
+
+    /**
+     * Waits until the behaviour of `m`, if any, has enqueued its messages on
+     * all of its cowns.
+     **/
+    static void wait_enqueued(MultiMessage* m)
+    {
+      auto* b = m->get_body();
+      if (b == nullptr)
+        return;
+
+      while (!b->enqueued.load(std::memory_order_acquire))
+      {
+        Aal::pause();
+        yield();
+      }
+    }
+
+    /// Returns the message for the `index`th cown of `body`.
+    static MultiMessage* get_message(MultiMessageBody* body, size_t index)
+    {
+      assert(index < body->count);
+      auto* messages =
+        pointer_offset<MultiMessage>(body->cowns, body->count * sizeof(Cown*));
+      return &messages[index];
+    }
+
+    /// Returns true if `body` acquires its `index`th cown read-only.
+    static bool is_read_only(MultiMessageBody* body, size_t index)
+    {
+      return get_message(body, index)->read_only;
+    }
+
+    /**
+     * Returns the message for the `index`th cown of `body`.
+     **/
     static MultiMessage*
-    make_message(Alloc& alloc, MultiMessageBody* body, EpochMark epoch)
+    make_message(MultiMessageBody* body, size_t index, EpochMark epoch)
     {
-      MultiMessage* m = make(alloc, epoch, body);
+      MultiMessage* m = make(get_message(body, index), epoch, body);
       Logging::cout() << "MultiMessage " << m << " payload " << body << " ("
                       << epoch << ")" << Logging::endl;
       return m;
     }
 
-    inline size_t size()
+    /**
+     * Creates a message with no body, for use as the initial stub of a
+     * cown's queue.
+     **/
+    static MultiMessage* make_stub(Alloc& alloc)
+    {
+      auto* m = make(
+        alloc.alloc<sizeof(MultiMessage)>(), EpochMark::EPOCH_NONE, nullptr);
+      m->read_only = false;
+      return m;
+    }
+
+    /**
+     * Called when this message is removed from a cown's queue.
+     **/
+    void dealloc(Alloc& alloc)
     {
-      return sizeof(MultiMessage);
+      auto* b = get_body();
+      if (b == nullptr)
+        alloc.dealloc<sizeof(MultiMessage)>(this);
+      else
+        release_body(alloc, b);
     }
   };
 } // namespace verona::rt
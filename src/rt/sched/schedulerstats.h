@@ -2,106 +2,323 @@
 // SPDX-License-Identifier: MIT
 #pragma once
 
+#include <atomic>
 #include <iostream>
 #include <snmalloc/snmalloc.h>
 
 namespace verona::rt
 {
   using namespace snmalloc;
+
+  /**
+   * A copy of the statistics of a scheduler thread, or the sum of several.
+   */
+  struct SchedulerStatsSnapshot
+  {
+    /// Number of buckets in the batch size histogram.  Bucket 0 counts runs
+    /// of a cown that processed no behaviours, bucket `i` counts runs that
+    /// processed `[2^(i-1), 2^i)` behaviours, and the last bucket also counts
+    /// all larger runs.
+    static constexpr size_t BATCH_BUCKETS = 8;
+
+    /// Systematic id of the thread, or 0 for a sum.
+    size_t thread_id = 0;
+    /// Number of behaviours run.
+    uint64_t behaviours = 0;
+    /// Number of times a cown was run.
+    uint64_t batches = 0;
+    /// Number of times a cown ran until it hit the batch limit.
+    uint64_t batch_limit_hits = 0;
+    /// Histogram of behaviours run each time a cown was run.
+    uint64_t batch_sizes[BATCH_BUCKETS] = {};
+    /// Number of cowns scheduled on this thread by enqueueing on its queue.
+    uint64_t fifo = 0;
+    /// Number of cowns scheduled on this thread at the front of its queue.
+    uint64_t lifo = 0;
+    /// Number of attempts to steal while looking for work.
+    uint64_t steal_attempts = 0;
+    /// Number of steals that found work.
+    uint64_t steals = 0;
+    /// Number of further cowns moved to this thread by batched steals.
+    uint64_t steal_moved = 0;
+    /// Number of times spinning for work found work, and the ticks spent.
+    uint64_t spins = 0;
+    uint64_t spin_ticks = 0;
+    /// Number of times this thread parked, and the ticks spent parked.
+    uint64_t pauses = 0;
+    uint64_t parked_ticks = 0;
+    /// Number of unpause calls that woke threads.
+    uint64_t unpauses = 0;
+    /// Number of cowns muted for sending to an overloaded cown.
+    uint64_t mutes = 0;
+    /// Number of leak detector cycles this thread completed, and the ticks
+    /// from starting to finishing them.
+    uint64_t lds = 0;
+    uint64_t ld_ticks = 0;
+    /// Ticks spent on leak detector walks over this thread's cowns.
+    uint64_t ld_work_ticks = 0;
+    /// Approximate number of cowns in the queue when the snapshot was taken.
+    size_t queue_depth = 0;
+
+    static size_t batch_bucket(size_t batch_size)
+    {
+      if (batch_size == 0)
+        return 0;
+
+      size_t bucket = bits::BITS - bits::clz(batch_size);
+      return (bucket < BATCH_BUCKETS) ? bucket : BATCH_BUCKETS - 1;
+    }
+
+    void add(const SchedulerStatsSnapshot& that)
+    {
+      behaviours += that.behaviours;
+      batches += that.batches;
+      batch_limit_hits += that.batch_limit_hits;
+      for (size_t i = 0; i < BATCH_BUCKETS; i++)
+        batch_sizes[i] += that.batch_sizes[i];
+      fifo += that.fifo;
+      lifo += that.lifo;
+      steal_attempts += that.steal_attempts;
+      steals += that.steals;
+      steal_moved += that.steal_moved;
+      spins += that.spins;
+      spin_ticks += that.spin_ticks;
+      pauses += that.pauses;
+      parked_ticks += that.parked_ticks;
+      unpauses += that.unpauses;
+      mutes += that.mutes;
+      lds += that.lds;
+      ld_ticks += that.ld_ticks;
+      ld_work_ticks += that.ld_work_ticks;
+      queue_depth += that.queue_depth;
+    }
+
+    void print(std::ostream& o, uint64_t dumpid = 0)
+    {
+      CSVStream csv(&o);
+
+      if (dumpid == 0)
+      {
+        // Output headers for initial dump
+        // Keep in sync with data dump
+        csv << "SchedulerStats"
+            << "DumpID"
+            << "Thread"
+            << "Behaviours"
+            << "Batches"
+            << "BatchLimit";
+        for (size_t i = 0; i < BATCH_BUCKETS; i++)
+          csv << ("Batch" + std::to_string(i == 0 ? 0 : (size_t)1 << (i - 1)));
+        csv << "FIFO"
+            << "LIFO"
+            << "StealAttempts"
+            << "Steal"
+            << "StealMoved"
+            << "Spin"
+            << "SpinTicks"
+            << "Pause"
+            << "ParkedTicks"
+            << "Unpause"
+            << "Mute"
+            << "LD"
+            << "LDTicks"
+            << "LDWorkTicks"
+            << "QueueDepth" << csv.endl;
+      }
+
+      csv << "SchedulerStats" << dumpid << thread_id << behaviours << batches
+          << batch_limit_hits;
+      for (size_t i = 0; i < BATCH_BUCKETS; i++)
+        csv << batch_sizes[i];
+      csv << fifo << lifo << steal_attempts << steals << steal_moved << spins
+          << spin_ticks << pauses << parked_ticks << unpauses << mutes << lds
+          << ld_ticks << ld_work_ticks << queue_depth << csv.endl;
+    }
+  };
+
+  /**
+   * Statistics of a scheduler thread.
+   *
+   * These are always collected, and can be read by other threads while the
+   * scheduler thread is running using `snapshot`.  Most counters are only
+   * written by the owning thread, so are updated with a relaxed load and
+   * store rather than a read-modify-write.
+   *
+   * If built with `USE_SCHED_STATS`, the sum over all threads is printed at
+   * exit.
+   */
   class SchedulerStats
   {
   private:
+    /// A counter that is only written by one thread, but may be read by
+    /// others.
+    class Counter
+    {
+      std::atomic<uint64_t> value{0};
+
+    public:
+      void add(uint64_t n = 1)
+      {
+        value.store(
+          value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+      }
+
+      uint64_t get() const
+      {
+        return value.load(std::memory_order_relaxed);
+      }
+    };
+
+    static constexpr size_t BATCH_BUCKETS =
+      SchedulerStatsSnapshot::BATCH_BUCKETS;
+
+    Counter behaviour_count;
+    Counter batch_count;
+    Counter batch_limit_count;
+    Counter batch_size_count[BATCH_BUCKETS];
+    Counter fifo_count;
+    Counter steal_attempt_count;
+    Counter steal_count;
+    Counter steal_moved_count;
+    Counter spin_count;
+    Counter spin_ticks;
+    Counter pause_count;
+    Counter parked_ticks;
+    Counter mute_count;
+    Counter ld_count;
+    Counter ld_ticks;
+    Counter ld_work_ticks;
+    // These may be updated by other threads scheduling work on this thread.
+    std::atomic<uint64_t> unpause_count = 0;
+    std::atomic<uint64_t> lifo_count = 0;
+
 #ifdef USE_SCHED_STATS
-    size_t steal_count = 0;
-    size_t pause_count = 0;
-    std::atomic<size_t> unpause_count = 0;
-    std::atomic<size_t> lifo_count = 0;
+    /// Sum of the statistics of all threads, printed at exit.
+    struct Total
+    {
+      SchedulerStatsSnapshot stats;
+
+      ~Total()
+      {
+        stats.print(std::cout);
+      }
+    };
 #endif
 
   public:
-    ~SchedulerStats()
 #ifdef USE_SCHED_STATS
+    ~SchedulerStats()
     {
       static snmalloc::FlagWord lock;
-      static SchedulerStats global;
+      static Total global;
 
-      if (this != &global)
-      {
-        FlagLock f(lock);
-        global.add(*this);
-      }
-      else
-      {
-        print(std::cout);
-      }
+      FlagLock f(lock);
+      global.stats.add(snapshot());
     }
-#else
-      = default;
 #endif
 
+    /// Records running a cown for `batch_size` behaviours.  `hit_limit` is
+    /// true if the cown stopped because it reached the batch limit.
+    void batch(size_t batch_size, bool hit_limit)
+    {
+      behaviour_count.add(batch_size);
+      batch_count.add();
+      batch_size_count[SchedulerStatsSnapshot::batch_bucket(batch_size)].add();
+      if (hit_limit)
+        batch_limit_count.add();
+    }
+
+    void fifo()
+    {
+      fifo_count.add();
+    }
+
+    void steal_attempt()
+    {
+      steal_attempt_count.add();
+    }
+
     void steal()
     {
-#ifdef USE_SCHED_STATS
-      steal_count++;
-#endif
+      steal_count.add();
     }
 
-    void pause()
+    /// Records cowns moved to this thread's queue by a batched steal.
+    void steal_batch(size_t moved)
     {
-#ifdef USE_SCHED_STATS
-      pause_count++;
-#endif
+      steal_moved_count.add(moved);
     }
 
-    void unpause()
+    /// Records a spin looking for work that found work after `ticks`.
+    void spin(uint64_t ticks)
     {
-#ifdef USE_SCHED_STATS
-      unpause_count++;
-#endif
+      spin_count.add();
+      spin_ticks.add(ticks);
     }
 
-    void lifo()
+    /// Records that this thread was parked for `ticks`.
+    void pause(uint64_t ticks)
     {
-#ifdef USE_SCHED_STATS
-      lifo_count++;
-#endif
+      pause_count.add();
+      parked_ticks.add(ticks);
     }
 
-    void add(SchedulerStats& that)
+    void mute()
     {
-      UNUSED(that);
+      mute_count.add();
+    }
 
-#ifdef USE_SCHED_STATS
-      steal_count += that.steal_count;
-      pause_count += that.pause_count;
-      unpause_count += that.unpause_count;
-      lifo_count += that.lifo_count;
-#endif
+    /// Records a leak detector cycle that took `ticks` on this thread.
+    void ld(uint64_t ticks)
+    {
+      ld_count.add();
+      ld_ticks.add(ticks);
     }
 
-    void print(std::ostream& o, uint64_t dumpid = 0)
+    /// Records `ticks` spent on a step of a leak detector walk.
+    void ld_work(uint64_t ticks)
     {
-      UNUSED(o);
-      UNUSED(dumpid);
+      ld_work_ticks.add(ticks);
+    }
 
-#ifdef USE_SCHED_STATS
-      CSVStream csv(&o);
+    void unpause()
+    {
+      unpause_count.fetch_add(1, std::memory_order_relaxed);
+    }
 
-      if (dumpid == 0)
-      {
-        // Output headers for initial dump
-        // Keep in sync with data dump
-        csv << "SchedulerStats"
-            << "DumpID"
-            << "Steal"
-            << "LIFO"
-            << "Pause"
-            << "Unpause" << csv.endl;
-      }
+    void lifo()
+    {
+      lifo_count.fetch_add(1, std::memory_order_relaxed);
+    }
 
-      csv << "SchedulerStats" << dumpid << steal_count << lifo_count
-          << pause_count << unpause_count << csv.endl;
-#endif
+    /**
+     * Copy the current values of the counters.  This can be called from any
+     * thread.  The counters are read individually, so may not be consistent
+     * with each other if the owning thread is running.
+     */
+    SchedulerStatsSnapshot snapshot() const
+    {
+      SchedulerStatsSnapshot s;
+      s.behaviours = behaviour_count.get();
+      s.batches = batch_count.get();
+      s.batch_limit_hits = batch_limit_count.get();
+      for (size_t i = 0; i < BATCH_BUCKETS; i++)
+        s.batch_sizes[i] = batch_size_count[i].get();
+      s.fifo = fifo_count.get();
+      s.lifo = lifo_count.load(std::memory_order_relaxed);
+      s.steal_attempts = steal_attempt_count.get();
+      s.steals = steal_count.get();
+      s.steal_moved = steal_moved_count.get();
+      s.spins = spin_count.get();
+      s.spin_ticks = spin_ticks.get();
+      s.pauses = pause_count.get();
+      s.parked_ticks = parked_ticks.get();
+      s.unpauses = unpause_count.load(std::memory_order_relaxed);
+      s.mutes = mute_count.get();
+      s.lds = ld_count.get();
+      s.ld_ticks = ld_ticks.get();
+      s.ld_work_ticks = ld_work_ticks.get();
+      return s;
     }
   };
 } // namespace verona::rt
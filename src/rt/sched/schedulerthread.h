@@ -9,10 +9,22 @@
 #include "schedulerstats.h"
 #include "threadpool.h"
 
+#include <algorithm>
 #include <snmalloc/snmalloc.h>
+#include <vector>
 
 namespace verona::rt
 {
+  /**
+   * The scheduling lane of a cown.  High priority cowns are run before normal
+   * priority cowns on the same scheduler thread.
+   */
+  enum class Priority : uint8_t
+  {
+    Normal,
+    High
+  };
+
   /**
    * There is typically one scheduler thread pinned to each physical CPU core.
    * Each scheduler thread is responsible for running cowns in its queue and
@@ -25,6 +37,14 @@ namespace verona::rt
    * on that thread. A scheduler thread will enqueue a new token, if its
    * previous one has been dequeued or stolen, once more work is scheduled on
    * the scheduler thread.
+   *
+   * High priority cowns are scheduled on a separate queue, which is drained
+   * first.  To keep the normal queue, and so the token cown, moving, a normal
+   * priority cown is run after every HIGH_PRIORITY_BURST high priority cowns.
+   * Cowns pinned to this thread are scheduled on queues that other threads
+   * never steal from: one drained with the high priority queue, for pinned
+   * cowns that are high priority, and one that takes turns with the normal
+   * queue, for the rest.
    */
   template<class T>
   class SchedulerThread
@@ -41,9 +61,42 @@ namespace verona::rt
     template<typename Owner>
     friend class Noticeboard;
 
+    /// Initial number of ticks to spin looking for work before parking.
+    /// This adapts, see `spin_found_work` and `parked_for`.
     static constexpr uint64_t TSC_QUIESCENCE_TIMEOUT = 1'000'000;
 
+    /// Maximum number of cowns taken from a victim's queue in one steal.
+    static constexpr size_t STEAL_BATCH_LIMIT = 32;
+
+    /// Maximum number of cowns counted when reporting queue depth.
+    static constexpr size_t QUEUE_DEPTH_LIMIT = 1024;
+
+    /// Maximum nesting of behaviours run inline by `Cown::fast_send`.
+    static constexpr size_t INLINE_DEPTH_LIMIT = 4;
+
+    /// Ticks this thread may spend running behaviours inline, before it must
+    /// return to its queue so other cowns get to run.
+    static constexpr uint64_t TSC_INLINE_BUDGET = 100'000;
+
+    /// Maximum number of high priority cowns run in a row while
+    /// normal priority cowns are waiting.
+    static constexpr size_t HIGH_PRIORITY_BURST = 8;
+
+    /// Maximum number of cowns visited by each step of a leak detector walk
+    /// over `list`, see `ld_step`.
+    static constexpr size_t LD_WALK_BUDGET = 128;
+
+    /// Number of cowns that must die, if the global epoch has not moved on,
+    /// before `collect_cown_stubs` looks at the dead cowns again.
+    static constexpr size_t STUB_BATCH = 64;
+
     T* token_cown = nullptr;
+    /// Token of the high priority queue.  This only takes part in the LD
+    /// protocol, not in stealing for fairness.
+    T* high_token_cown = nullptr;
+    /// Tokens of the pinned queues, as for the high priority queue.
+    T* pinned_token_cown = nullptr;
+    T* pinned_high_token_cown = nullptr;
 
 #ifdef USE_SYSTEMATIC_TESTING
     friend class ThreadSyncSystematic<SchedulerThread>;
@@ -54,15 +107,40 @@ namespace verona::rt
 #endif
 
     MPMCQ<T> q;
+    MPMCQ<T> q_high;
+    /// Cowns pinned to this thread, at normal and high priority.  Only this
+    /// thread dequeues from these.
+    MPMCQ<T> q_pinned;
+    MPMCQ<T> q_pinned_high;
     Alloc* alloc = nullptr;
     SchedulerThread<T>* next = nullptr;
-    SchedulerThread<T>* victim = nullptr;
+
+    /// The other scheduler threads, ordered by topological distance from
+    /// this thread, nearest first.  Threads at the same distance are in the
+    /// order they follow this thread in the `next` ring.
+    std::vector<SchedulerThread<T>*> victims;
+    /// Index into `victims` of the next thread to steal from for fairness.
+    size_t victim = 0;
+
+    /// Current number of ticks to spin looking for work before parking.
+    uint64_t spin_budget = TSC_QUIESCENCE_TIMEOUT;
 
     bool running = true;
 
     // `n_ld_tokens` indicates the times of token cown a scheduler has to
     // process before reaching its LD checkpoint (`n_ld_tokens == 0`).
     uint8_t n_ld_tokens = 0;
+    /// As `n_ld_tokens`, for the high priority and pinned queues.
+    uint8_t n_high_ld_tokens = 0;
+    uint8_t n_pinned_ld_tokens = 0;
+    uint8_t n_pinned_high_ld_tokens = 0;
+
+    /// Number of high priority cowns run in a row, see `dequeue_local`.
+    size_t high_burst = 0;
+
+    /// True if the pinned queue, rather than the normal queue, is next to be
+    /// taken from at normal priority, see `dequeue_local`.
+    bool pinned_turn = false;
 
     bool should_steal_for_fairness = false;
 
@@ -74,22 +152,83 @@ namespace verona::rt
     ThreadState::State state = ThreadState::State::NotInLD;
     SchedulerStats stats;
 
+    /// The cowns owned by this thread, see `add_to_list`.
     T* list = nullptr;
     size_t total_cowns = 0;
+    /// Number of cowns in `list` whose weak count has reached zero, and
+    /// whose stubs have not been freed yet.
     std::atomic<size_t> free_cowns = 0;
 
+    /// Cowns in `list` whose weak count has reached zero since the last
+    /// `collect_cown_stubs`.  Any thread may push onto this, see `add_dead`.
+    std::atomic<T*> dead{nullptr};
+    /// Cowns taken from `dead` whose stubs could not be freed yet, as another
+    /// thread may still read them.  Linked through `next_dead`.
+    T* dead_pending = nullptr;
+    size_t dead_pending_count = 0;
+    /// Global epoch when `collect_cown_stubs` last ran.
+    uint64_t stub_epoch = 0;
+
+    /**
+     * The leak detector walks over `list` when it starts scanning, to
+     * reschedule the cowns that are roots, and when it sweeps.  These walks
+     * are done a bounded step at a time from `ld_protocol`, so a thread with
+     * many cowns keeps running behaviours in between.  The protocol does not
+     * advance on this thread until the walk is finished.
+     */
+    enum class LDWalk : uint8_t
+    {
+      None,
+      Reschedule,
+      Sweep
+    };
+    LDWalk ld_walk = LDWalk::None;
+    /// Next cown of `list` to visit in the current walk.
+    T* ld_cursor = nullptr;
+
+    /// Tick at which this thread joined the current or last leak detector
+    /// cycle, or zero if it never has.
+    uint64_t ld_start = 0;
+    /// Ticks the last cycle took on this thread, and the tick it finished.
+    uint64_t ld_last_ticks = 0;
+    uint64_t ld_last_end = 0;
+    /// Value of `total_cowns` when the last cycle finished on this thread.
+    size_t ld_last_cowns = 0;
+
     /// The MessageBody of a running behaviour.
     typename T::MessageBody* message_body = nullptr;
 
+    /// An overloaded cown that the running behaviour has sent to, on which
+    /// the cowns of the behaviour are muted when it completes.
+    T* mutor = nullptr;
+
+    /// Nesting depth of behaviours currently being run inline.
+    size_t inline_depth = 0;
+
+    /// Tick at which this thread first ran a behaviour inline since it last
+    /// took a cown from its queue, or 0 if it has not.
+    uint64_t inline_start = 0;
+
     T* get_token_cown()
     {
       assert(token_cown);
       return token_cown;
     }
 
-    SchedulerThread() : token_cown{T::create_token_cown()}, q{token_cown}
+    SchedulerThread()
+    : token_cown{T::create_token_cown()},
+      high_token_cown{T::create_token_cown()},
+      pinned_token_cown{T::create_token_cown()},
+      pinned_high_token_cown{T::create_token_cown()},
+      q{token_cown},
+      q_high{high_token_cown},
+      q_pinned{pinned_token_cown},
+      q_pinned_high{pinned_high_token_cown}
     {
       token_cown->set_owning_thread(this);
+      high_token_cown->set_owning_thread(this);
+      pinned_token_cown->set_owning_thread(this);
+      pinned_high_token_cown->set_owning_thread(this);
     }
 
     ~SchedulerThread() {}
@@ -101,17 +240,20 @@ namespace verona::rt
 
     inline void schedule_fifo(T* a)
     {
+      if (is_pinned_elsewhere(a))
+      {
+        a->get_pinned()->schedule_pinned(a);
+        return;
+      }
+
       Logging::cout() << "Enqueue cown " << a << " (" << a->get_epoch_mark()
                       << ")" << Logging::endl;
 
       // Scheduling on this thread, from this thread.
-      if (!a->scanned(send_epoch))
-      {
-        Logging::cout() << "Enqueue unscanned cown " << a << Logging::endl;
-        scheduled_unscanned_cown = true;
-      }
+      check_scanned(a);
       assert(!a->queue.is_sleeping());
-      q.enqueue(*alloc, a);
+      lane(a).enqueue(*alloc, a);
+      stats.fifo();
 
       if (Scheduler::get().unpause())
         stats.unpause();
@@ -119,11 +261,19 @@ namespace verona::rt
 
     inline void schedule_lifo(T* a)
     {
+      // This may not be called on this thread, so its pinned thread may be
+      // paused.
+      if (a->get_pinned() != nullptr)
+      {
+        a->get_pinned()->schedule_pinned(a);
+        return;
+      }
+
       // A lifo scheduled cown is coming from an external source, such as
       // asynchronous I/O.
       Logging::cout() << "LIFO scheduling cown " << a << " onto "
                       << systematic_id << Logging::endl;
-      q.enqueue_front(ThreadAlloc::get(), a);
+      lane(a).enqueue_front(ThreadAlloc::get(), a);
       Logging::cout() << "LIFO scheduled cown " << a << " onto "
                       << systematic_id << Logging::endl;
 
@@ -133,6 +283,69 @@ namespace verona::rt
         stats.unpause();
     }
 
+    /**
+     * Schedules a cown pinned to this thread, from any thread, including
+     * threads outside the runtime.  As this thread may be paused, and only
+     * it can run the cown, all paused threads are woken.
+     *
+     * The cown is not checked for the LD protocol here, as that reads the
+     * state of this thread.  It is checked when this thread runs it.
+     */
+    void schedule_pinned(T* a)
+    {
+      Logging::cout() << "Enqueue pinned cown " << a << " onto "
+                      << systematic_id << Logging::endl;
+      lane(a).enqueue(ThreadAlloc::get(), a);
+      Scheduler::get().unpause_all();
+    }
+
+    /**
+     * Polls the file descriptors watched by cowns, and notifies the cowns
+     * watching those that are ready, so they are scheduled on this thread.
+     * Waits for up to `timeout_ms` milliseconds, or forever if it is -1, for
+     * one to be ready, or for an unpause.  Returns true if any cown was
+     * notified.
+     */
+    bool poll_io(int timeout_ms)
+    {
+      return Scheduler::io_poller().poll(timeout_ms, [](void* c) {
+        Logging::cout() << "I/O ready for cown " << c << Logging::endl;
+        ((T*)c)->mark_notify();
+      });
+    }
+
+    /**
+     * Fires the timers that are due, which schedule their behaviours on this
+     * thread.  Returns true if any timer fired.
+     */
+    bool fire_timers()
+    {
+      auto fire = [](Timer* t) { t->fire(t); };
+      auto idle = []() { Scheduler::remove_external_event_source(); };
+      return Scheduler::timer_wheel().advance(fire, idle) != 0;
+    }
+
+    /**
+     * Scans the cowns that pending timers will schedule behaviours on, as
+     * they may not be reachable from anything else.  Each thread does this
+     * when it starts scanning, as a timer added by a thread that has not yet
+     * started is not scanned when it is added, see `Scheduler::add_timer`.
+     */
+    void scan_timers()
+    {
+      ObjectStack f(*alloc);
+      Scheduler::timer_wheel().trace(f);
+      T::scan_stack(*alloc, send_epoch, f);
+    }
+
+    /// Scans the cowns that the timer `t` will schedule behaviours on.
+    void scan_timer(Timer* t)
+    {
+      ObjectStack f(*alloc);
+      t->trace(t, f);
+      T::scan_stack(*alloc, send_epoch, f);
+    }
+
     template<typename... Args>
     static void run(SchedulerThread* t, void (*startup)(Args...), Args... args)
     {
@@ -152,7 +365,11 @@ namespace verona::rt
 
       Scheduler::local() = this;
       alloc = &ThreadAlloc::get();
-      victim = next;
+      victim = 0;
+      spin_budget = std::clamp(
+        TSC_QUIESCENCE_TIMEOUT,
+        Scheduler::get().spin_min,
+        Scheduler::get().spin_max);
       T* cown = nullptr;
 
 #ifdef USE_SYSTEMATIC_TESTING
@@ -161,8 +378,11 @@ namespace verona::rt
 
       while (true)
       {
+        fire_timers();
+        ld_trigger();
+
         if (
-          (total_cowns < (free_cowns << 1))
+          should_collect_stubs()
 #ifdef USE_SYSTEMATIC_TESTING
           || Systematic::coin()
 #endif
@@ -180,7 +400,7 @@ namespace verona::rt
 
         if (cown == nullptr)
         {
-          cown = q.dequeue(*alloc);
+          cown = dequeue_local();
           if (cown != nullptr)
             Logging::cout()
               << "Pop cown " << clear_thread_bit(cown) << Logging::endl;
@@ -222,11 +442,12 @@ namespace verona::rt
 
         Logging::cout() << "Running cown " << cown << Logging::endl;
 
+        inline_start = 0;
         bool reschedule = cown->run(*alloc, state);
 
         if (reschedule)
         {
-          if (should_steal_for_fairness)
+          if (should_steal_for_fairness || is_pinned_elsewhere(cown))
           {
             schedule_fifo(cown);
             cown = nullptr;
@@ -238,7 +459,7 @@ namespace verona::rt
             // otherwise run this cown again. Don't push to the queue
             // immediately to avoid another thread stealing our only cown.
 
-            T* n = q.dequeue(*alloc);
+            T* n = dequeue_local();
 
             if (n != nullptr)
             {
@@ -303,6 +524,9 @@ namespace verona::rt
       Logging::cout() << "End teardown (phase 2)" << Logging::endl;
 
       q.destroy(*alloc);
+      q_high.destroy(*alloc);
+      q_pinned.destroy(*alloc);
+      q_pinned_high.destroy(*alloc);
 
       Systematic::finished_thread();
 
@@ -311,28 +535,292 @@ namespace verona::rt
       Scheduler::local() = nullptr;
     }
 
-    bool fast_steal(T*& result)
+    /**
+     * Computes the order in which this thread tries to steal from the other
+     * threads.  `index` is this thread's position in the `next` ring, which
+     * is also the position at which it was pinned by the ThreadPoolBuilder.
+     */
+    void init_victims(size_t index, size_t count)
     {
-      // auto cur_victim = victim;
-      T* cown;
+      std::vector<std::pair<size_t, SchedulerThread<T>*>> order;
+      size_t offset = 1;
 
-      // Try to steal from the victim thread.
-      if (victim != this)
+      for (auto t = next; t != this; t = t->next)
       {
-        cown = victim->q.dequeue(*alloc);
+        order.emplace_back(
+          ThreadPoolBuilder::distance(index, (index + offset) % count), t);
+        offset++;
+      }
+
+      std::stable_sort(
+        order.begin(), order.end(), [](const auto& a, const auto& b) {
+          return a.first < b.first;
+        });
+
+      victims.clear();
+      for (auto& v : order)
+        victims.push_back(v.second);
+    }
 
+    /**
+     * Attempts to dequeue a cown from the victim at `index` in `victims`.
+     * On failure, moves `index` on to the next victim, so that repeated
+     * calls work outwards from the nearest threads to the most remote.
+     */
+    T* try_steal_from(size_t& index)
+    {
+      if (victims.empty())
+        return nullptr;
+
+      T* cown = victims[index]->q.dequeue(*alloc);
+
+      if (cown == nullptr)
+        next_victim(index);
+
+      return cown;
+    }
+
+    /**
+     * Attempts to take up to half of the queue of the victim at `index` in
+     * `victims`.  The first cown is returned, and the rest are moved onto
+     * this thread's queue with a single enqueue.  On failure, moves `index`
+     * on to the next victim.
+     */
+    T* try_steal_half_from(size_t& index)
+    {
+      if (victims.empty())
+        return nullptr;
+
+      stats.steal_attempt();
+
+      T* rest_first;
+      T* rest_last;
+      T* cown = victims[index]->q.dequeue_half(
+        *alloc, STEAL_BATCH_LIMIT, rest_first, rest_last);
+
+      if (cown == nullptr)
+      {
+        next_victim(index);
+        return nullptr;
+      }
+
+      if (rest_first != nullptr)
+      {
+        // The moved cowns are scheduled on this thread without passing
+        // through `schedule_fifo`, so check them for the LD protocol here.
+        size_t moved = 1;
+        for (T* c = rest_first; c != rest_last; c = c->next_in_queue)
+        {
+          check_scanned(c);
+          moved++;
+        }
+        check_scanned(rest_last);
+
+        q.enqueue_segment(*alloc, rest_first, rest_last);
+        stats.steal_batch(moved);
+        Logging::cout() << "Moved " << moved << " cowns from "
+                        << victims[index]->systematic_id << Logging::endl;
+
+        // There is more work on this queue than this thread can run now, so
+        // let a paused thread come and take some of it.
+        if (Scheduler::get().unpause())
+          stats.unpause();
+      }
+
+      return cown;
+    }
+
+    /**
+     * Attempts to dequeue a high priority cown from the victim at `index` in
+     * `victims`.  Does not move on to the next victim, so that the normal
+     * queue of the same victim is tried next.
+     */
+    T* try_steal_high_from(size_t index)
+    {
+      if (victims.empty())
+        return nullptr;
+
+      return victims[index]->dequeue_high(*alloc, false);
+    }
+
+    void next_victim(size_t& index)
+    {
+      index++;
+      if (index == victims.size())
+        index = 0;
+    }
+
+    /**
+     * Copy the statistics of this thread.  This can be called from any
+     * thread while the runtime is running.
+     */
+    SchedulerStatsSnapshot snapshot_stats()
+    {
+      auto s = stats.snapshot();
+      s.thread_id = systematic_id;
+      s.queue_depth =
+        q.approximate_length(ThreadAlloc::get(), QUEUE_DEPTH_LIMIT) +
+        q_high.approximate_length(ThreadAlloc::get(), QUEUE_DEPTH_LIMIT) +
+        q_pinned.approximate_length(ThreadAlloc::get(), QUEUE_DEPTH_LIMIT) +
+        q_pinned_high.approximate_length(ThreadAlloc::get(), QUEUE_DEPTH_LIMIT);
+      return s;
+    }
+
+    /// Returns the queue of this thread on which `cown` is scheduled.
+    MPMCQ<T>& lane(T* cown)
+    {
+      bool high = cown->get_priority() == Priority::High;
+      if (cown->get_pinned() == this)
+        return high ? q_pinned_high : q_pinned;
+      return high ? q_high : q;
+    }
+
+    bool is_pinned_elsewhere(T* cown)
+    {
+      auto* p = cown->get_pinned();
+      return (p != nullptr) && (p != this);
+    }
+
+    /**
+     * Returns true if nothing older than this call is in any queue, see
+     * `MPMCQ::nothing_old`.
+     */
+    bool nothing_old()
+    {
+      return q_high.nothing_old() && q_pinned_high.nothing_old() &&
+        q_pinned.nothing_old() && q.nothing_old();
+    }
+
+    /**
+     * Takes a cown from the high priority or pinned queue `lane`, whose LD
+     * token count is `tokens`.  The token of the queue is put straight back,
+     * as it only marks a point in the queue for the LD protocol.  `owner` is
+     * true if this is called by the thread that owns the queue, rather than
+     * a thief.
+     */
+    T* dequeue_lane(MPMCQ<T>& lane, uint8_t& tokens, Alloc& a, bool owner)
+    {
+      for (size_t i = 0; i < 2; i++)
+      {
+        T* cown = lane.dequeue(a);
+        if (cown == nullptr)
+        {
+          // The queue is rarely used, so its token may not come round.
+          if (owner && lane.nothing_old())
+            tokens = 0;
+          return nullptr;
+        }
+
+        if (!has_thread_bit(cown))
+          return cown;
+
+        if (owner && (tokens > 0))
+        {
+          Logging::cout() << "Reached lane LD token" << Logging::endl;
+          tokens--;
+        }
+        lane.enqueue(a, cown);
+      }
+      return nullptr;
+    }
+
+    T* dequeue_high(Alloc& a, bool owner)
+    {
+      return dequeue_lane(q_high, n_high_ld_tokens, a, owner);
+    }
+
+    T* dequeue_pinned(bool high)
+    {
+      if (high)
+        return dequeue_lane(
+          q_pinned_high, n_pinned_high_ld_tokens, *alloc, true);
+      return dequeue_lane(q_pinned, n_pinned_ld_tokens, *alloc, true);
+    }
+
+    /**
+     * Takes the next cown to run from this thread's queues.  High priority
+     * cowns, pinned or not, are taken first, unless HIGH_PRIORITY_BURST of
+     * them have been run in a row, in which case a normal priority cown gets
+     * a turn.  At normal priority, the normal and pinned queues take turns.
+     */
+    T* dequeue_local()
+    {
+      if (high_burst < HIGH_PRIORITY_BURST)
+      {
+        T* cown = dequeue_high(*alloc, true);
+        if (cown == nullptr)
+          cown = dequeue_pinned(true);
         if (cown != nullptr)
         {
-          // stats.steal();
-          Logging::cout() << "Fast-steal cown " << clear_thread_bit(cown)
-                          << " from " << victim->systematic_id << Logging::endl;
-          result = cown;
-          return true;
+          high_burst++;
+          return cown;
         }
       }
 
-      // We were unable to steal, move to the next victim thread.
-      victim = victim->next;
+      high_burst = 0;
+      pinned_turn = !pinned_turn;
+      T* cown = pinned_turn ? dequeue_pinned(false) : q.dequeue(*alloc);
+      if (cown == nullptr)
+        cown = pinned_turn ? q.dequeue(*alloc) : dequeue_pinned(false);
+      if (cown == nullptr)
+        cown = dequeue_high(*alloc, true);
+      if (cown == nullptr)
+        cown = dequeue_pinned(true);
+      return cown;
+    }
+
+    /**
+     * Checks whether a behaviour can be run inline, within the nesting and
+     * time budget.  If this returns true, then `end_inline` must be called
+     * once the behaviour has run.
+     */
+    bool start_inline()
+    {
+      if (inline_depth >= INLINE_DEPTH_LIMIT)
+        return false;
+
+      uint64_t now = Aal::tick();
+      if (inline_start == 0)
+        inline_start = now;
+      else if ((now - inline_start) > TSC_INLINE_BUDGET)
+        return false;
+
+      inline_depth++;
+      return true;
+    }
+
+    void end_inline()
+    {
+      assert(inline_depth > 0);
+      inline_depth--;
+    }
+
+    void check_scanned(T* cown)
+    {
+      if (!cown->scanned(send_epoch))
+      {
+        Logging::cout() << "Enqueue unscanned cown " << cown << Logging::endl;
+        scheduled_unscanned_cown = true;
+      }
+    }
+
+    bool fast_steal(T*& result)
+    {
+      auto cur_victim = victim;
+
+      // Try to steal from the victim thread.  On failure, this moves to the
+      // next victim thread.
+      T* cown = try_steal_from(victim);
+
+      if (cown != nullptr)
+      {
+        // stats.steal();
+        Logging::cout() << "Fast-steal cown " << clear_thread_bit(cown)
+                        << " from " << victims[cur_victim]->systematic_id
+                        << Logging::endl;
+        result = cown;
+        return true;
+      }
 
       return false;
     }
@@ -344,11 +832,45 @@ namespace verona::rt
       n_ld_tokens--;
     }
 
+    /**
+     * Called when spinning for `spun` ticks found work.  If most of the
+     * budget was used, then work tends to arrive just before this thread
+     * would give up, so spin for longer.
+     */
+    void spin_found_work(uint64_t spun)
+    {
+      stats.spin(spun);
+
+      if (spun > spin_budget / 2)
+        spin_budget = (std::min)(spin_budget * 2, Scheduler::get().spin_max);
+    }
+
+    /**
+     * Called when this thread has been parked for `parked` ticks.  Being
+     * woken soon after parking means a slightly longer spin would have
+     * avoided the cost of sleeping and waking, so spin for longer.  Being
+     * parked for much longer than the spin means spinning was wasted, so
+     * spin for less.
+     */
+    void parked_for(uint64_t parked)
+    {
+      if (parked < spin_budget)
+        spin_budget = (std::min)(spin_budget * 2, Scheduler::get().spin_max);
+      else if (parked > spin_budget * 16)
+        spin_budget = (std::max)(spin_budget / 2, Scheduler::get().spin_min);
+    }
+
     T* steal()
     {
       uint64_t tsc = Aal::tick();
+      bool spinning = false;
       T* cown;
 
+      // Look for work starting from the nearest threads, so that stolen cowns
+      // are more likely to have their state in a shared cache or local
+      // memory.  Only move on to remote threads once those have no work.
+      size_t steal_victim = 0;
+
       while (running)
       {
         yield();
@@ -361,30 +883,38 @@ namespace verona::rt
         // Participate in the cown LD protocol.
         ld_protocol();
 
+        fire_timers();
+
         // Check if some other thread has pushed work on our queue.
-        cown = q.dequeue(*alloc);
+        cown = dequeue_local();
 
         if (cown != nullptr)
+        {
+          if (spinning)
+            spin_found_work(Aal::tick() - tsc);
           return cown;
+        }
 
-        // Try to steal from the victim thread.
-        if (victim != this)
-        {
-          cown = victim->q.dequeue(*alloc);
+        // Try to steal from the victim thread, taking up to half of its
+        // queue so that a backlog spreads in one step rather than one cown
+        // per steal. If we are unable to steal, this moves to the next victim
+        // thread.
+        auto cur_victim = steal_victim;
+        cown = try_steal_high_from(steal_victim);
+        if (cown == nullptr)
+          cown = try_steal_half_from(steal_victim);
 
-          if (cown != nullptr)
-          {
-            stats.steal();
-            Logging::cout()
-              << "Stole cown " << clear_thread_bit(cown) << " from "
-              << victim->systematic_id << Logging::endl;
-            return cown;
-          }
+        if (cown != nullptr)
+        {
+          if (spinning)
+            spin_found_work(Aal::tick() - tsc);
+          stats.steal();
+          Logging::cout() << "Stole cown " << clear_thread_bit(cown) << " from "
+                          << victims[cur_victim]->systematic_id
+                          << Logging::endl;
+          return cown;
         }
 
-        // We were unable to steal, move to the next victim thread.
-        victim = victim->next;
-
 #ifdef USE_SYSTEMATIC_TESTING
         // Only try to pause with 1/(2^5) probability
         UNUSED(tsc);
@@ -394,22 +924,33 @@ namespace verona::rt
           continue;
         }
 #else
-        // Wait until a minimum timeout has passed.
+        // Spin until the budget for this thread has passed.
         uint64_t tsc2 = Aal::tick();
-        if ((tsc2 - tsc) < TSC_QUIESCENCE_TIMEOUT)
+        if ((tsc2 - tsc) < spin_budget)
         {
+          spinning = true;
           Aal::pause();
           continue;
         }
 #endif
 
+        // Pick up any I/O before parking.
+        if (poll_io(0))
+          continue;
+
         // Enter sleep only if we aren't executing the leak detector currently.
         if (state == ThreadState::NotInLD)
         {
           // We've been spinning looking for work for some time. While paused,
           // our running flag may be set to false, in which case we terminate.
+          uint64_t park_start = Aal::tick();
           if (Scheduler::get().pause())
-            stats.pause();
+          {
+            tsc = Aal::tick();
+            stats.pause(tsc - park_start);
+            parked_for(tsc - park_start);
+            spinning = false;
+          }
         }
       }
 
@@ -456,6 +997,9 @@ namespace verona::rt
             dec_n_ld_tokens();
           }
 
+          // A busy thread may not look for work, so picks up I/O here.
+          poll_io(0);
+
           Logging::cout() << "Reached token" << Logging::endl;
         }
         else
@@ -476,9 +1020,7 @@ namespace verona::rt
         Logging::cout() << "Bind cown to scheduler thread: " << this
                         << Logging::endl;
         cown->set_owning_thread(this);
-        cown->next = list;
-        list = cown;
-        total_cowns++;
+        add_to_list(cown);
       }
 
       return true;
@@ -503,7 +1045,81 @@ namespace verona::rt
 
     bool ld_checkpoint_reached()
     {
-      return n_ld_tokens == 0;
+      return (ld_walk == LDWalk::None) && (n_ld_tokens == 0) &&
+        (n_high_ld_tokens == 0) && (n_pinned_ld_tokens == 0) &&
+        (n_pinned_high_ld_tokens == 0);
+    }
+
+    /**
+     * Starts a leak detector cycle if enough cowns have been bound to this
+     * thread since its last one, and enough time has passed since then to
+     * keep cycles within their share of time, see `set_ld_trigger`.
+     */
+    void ld_trigger()
+    {
+      auto& s = Scheduler::get();
+      if (
+        (s.ld_cowns == 0) || (state != ThreadState::NotInLD) ||
+        (total_cowns - ld_last_cowns < s.ld_cowns))
+        return;
+
+      // A cycle that took `d` ticks is followed by at least
+      // `d * (100 - p) / p` ticks without one, for a share of `p` percent.
+      uint64_t gap =
+        ld_last_ticks * (100 - s.ld_max_overhead) / s.ld_max_overhead;
+      if ((ld_start != 0) && (Aal::tick() - ld_last_end < gap))
+        return;
+
+      Logging::cout() << "Trigger LD after " << (total_cowns - ld_last_cowns)
+                      << " cowns" << Logging::endl;
+      want_ld();
+    }
+
+    /**
+     * Takes a bounded step of the walk over `list` in progress, if there is
+     * one.  Returns true once there is no walk in progress.
+     */
+    bool ld_step()
+    {
+      if (ld_walk == LDWalk::None)
+        return true;
+
+      uint64_t start = Aal::tick();
+      for (size_t i = 0; (i < LD_WALK_BUDGET) && (ld_cursor != nullptr); i++)
+      {
+        T* p = ld_cursor;
+        ld_cursor = p->next;
+
+        if (ld_walk == LDWalk::Reschedule)
+        {
+          // Send empty messages to all cowns that can be LIFO scheduled.
+          if (p->can_lifo_schedule())
+            p->reschedule();
+        }
+        else
+        {
+          p->try_collect(*alloc, send_epoch);
+        }
+      }
+
+      if (ld_cursor == nullptr)
+      {
+        // Only count the tokens from the end of the walk, so that cowns
+        // rescheduled late in the walk are still ahead of the checkpoint.
+        if (ld_walk == LDWalk::Reschedule)
+        {
+          n_ld_tokens = 2;
+          n_high_ld_tokens = 2;
+          n_pinned_ld_tokens = 2;
+          n_pinned_high_ld_tokens = 2;
+          scheduled_unscanned_cown = false;
+          Logging::cout() << "Enqueued LD check point" << Logging::endl;
+        }
+        ld_walk = LDWalk::None;
+      }
+
+      stats.ld_work(Aal::tick() - start);
+      return ld_walk == LDWalk::None;
     }
 
     /**
@@ -513,6 +1129,9 @@ namespace verona::rt
      **/
     void ld_protocol()
     {
+      if (!ld_step())
+        return;
+
       // Set state to BelieveDone_Vote when we think we've finished scanning.
       if ((state == ThreadState::AllInScan) && ld_checkpoint_reached())
       {
@@ -543,7 +1162,7 @@ namespace verona::rt
         // trying to perform a LD.
         if (
           sprev == ThreadState::PreScan && snext == ThreadState::PreScan &&
-          Scheduler::get().unpause())
+          Scheduler::get().unpause_all())
         {
           stats.unpause();
         }
@@ -565,7 +1184,8 @@ namespace verona::rt
         {
           case ThreadState::PreScan:
           {
-            if (Scheduler::get().unpause())
+            // Every thread must take part in the LD protocol.
+            if (Scheduler::get().unpause_all())
               stats.unpause();
 
             enter_prescan();
@@ -603,7 +1223,11 @@ namespace verona::rt
 
           case ThreadState::Sweep:
           {
-            collect_cowns();
+            // Only vote to finish once this thread's cowns are swept.
+            ld_walk = LDWalk::Sweep;
+            ld_cursor = list;
+            if (!ld_step())
+              return;
             continue;
           }
 
@@ -620,10 +1244,31 @@ namespace verona::rt
       return state == ThreadState::Sweep;
     }
 
+    /// Returns true if a thread in state `s` is not taking part in a leak
+    /// detector cycle.
+    static bool ld_idle(ThreadState::State s)
+    {
+      return (s == ThreadState::NotInLD) || (s == ThreadState::WantLD) ||
+        (s == ThreadState::Finished);
+    }
+
     void ld_state_change(ThreadState::State snext)
     {
       Logging::cout() << "Scheduler state change: " << state << " -> " << snext
                       << Logging::endl;
+
+      if (ld_idle(state) && !ld_idle(snext))
+      {
+        ld_start = Aal::tick();
+      }
+      else if (!ld_idle(state) && ld_idle(snext))
+      {
+        ld_last_end = Aal::tick();
+        ld_last_ticks = ld_last_end - ld_start;
+        ld_last_cowns = total_cowns;
+        stats.ld(ld_last_ticks);
+      }
+
       state = snext;
     }
 
@@ -646,32 +1291,76 @@ namespace verona::rt
                                                         EpochMark::EPOCH_B;
       Logging::cout() << "send_epoch (2): " << send_epoch << Logging::endl;
 
-      // Send empty messages to all cowns that can be LIFO scheduled.
-
-      T* p = list;
-      while (p != nullptr)
-      {
-        if (p->can_lifo_schedule())
-          p->reschedule();
+      scan_timers();
 
-        p = p->next;
-      }
+      // Restarts the walk if a previous scan did not finish.
+      ld_walk = LDWalk::Reschedule;
+      ld_cursor = list;
+      ld_step();
+    }
 
-      n_ld_tokens = 2;
-      scheduled_unscanned_cown = false;
-      Logging::cout() << "Enqueued LD check point" << Logging::endl;
+    /// Adds `cown` to the front of `list`.
+    void add_to_list(T* cown)
+    {
+      cown->prev = nullptr;
+      cown->next = list;
+      if (list != nullptr)
+        list->prev = cown;
+      list = cown;
+      total_cowns++;
     }
 
-    void collect_cowns()
+    void remove_from_list(T* cown)
     {
-      T* p = list;
+      // Keep a walk in progress on the next cown.
+      if (cown == ld_cursor)
+        ld_cursor = cown->next;
+
+      if (cown->prev != nullptr)
+        cown->prev->next = cown->next;
+      else
+        list = cown->next;
 
-      while (p != nullptr)
+      if (cown->next != nullptr)
+        cown->next->prev = cown->prev;
+    }
+
+    /**
+     * Called by any thread when the weak count of `cown`, which is in `list`,
+     * reaches zero.  Collecting stubs then only visits the cowns that have
+     * died, rather than every cown of this thread.
+     */
+    void add_dead(T* cown)
+    {
+      T* head = dead.load(std::memory_order_relaxed);
+      do
       {
-        T* n = p->next;
-        p->try_collect(*alloc, send_epoch);
-        p = n;
-      }
+        cown->next_dead = head;
+      } while (!dead.compare_exchange_weak(
+        head, cown, std::memory_order_release, std::memory_order_relaxed));
+      free_cowns++;
+    }
+
+    /**
+     * Returns true if `collect_cown_stubs` may free some stubs, because cowns
+     * have died since it last ran and either the global epoch has moved on,
+     * or a batch of cowns have died.
+     */
+    bool should_collect_stubs()
+    {
+      size_t f = free_cowns.load(std::memory_order_relaxed);
+      return (f > dead_pending_count) &&
+        ((GlobalEpoch::get() != stub_epoch) ||
+         (f - dead_pending_count >= STUB_BATCH) ||
+         (dead_pending_count == 0));
+    }
+
+    /// Returns true if no other thread can still read the stub of `cown`.
+    static bool stub_outdated(T* cown)
+    {
+      // TODO: Investigate systematic testing coverage here.
+      auto epoch = cown->epoch_when_popped;
+      return epoch == T::NO_EPOCH_SET || GlobalEpoch::is_outdated(epoch);
     }
 
     template<bool during_teardown = false>
@@ -684,53 +1373,97 @@ namespace verona::rt
       switch (state)
       {
         case ThreadState::ReallyDone_Confirm:
+        case ThreadState::Sweep:
         case ThreadState::Finished:
           return;
 
         default:;
       }
 
-      T** p = &list;
-      size_t count = 0;
+      if constexpr (during_teardown)
+      {
+        collect_all_cown_stubs();
+        return;
+      }
 
+      // Take the cowns that have died since the last call.
+      T* c = dead.exchange(nullptr, std::memory_order_acquire);
+      while (c != nullptr)
+      {
+        T* n = c->next_dead;
+        c->next_dead = dead_pending;
+        dead_pending = c;
+        dead_pending_count++;
+        c = n;
+      }
+      stub_epoch = GlobalEpoch::get();
+
+      T** p = &dead_pending;
+      size_t count = 0;
       while (*p != nullptr)
       {
-        T* c = *p;
-        // Collect cown stubs when the weak count is zero.
-        if (c->weak_count == 0 || during_teardown)
+        c = *p;
+        assert(c->weak_count == 0);
+        if (stub_outdated(c))
         {
-          if (c->weak_count != 0)
-          {
-            Logging::cout() << "Leaking cown " << c << Logging::endl;
-            if (Scheduler::get_detect_leaks())
-            {
-              *p = c->next;
-              continue;
-            }
-          }
-          Logging::cout() << "Stub collect cown " << c << Logging::endl;
-          // TODO: Investigate systematic testing coverage here.
-          auto epoch = c->epoch_when_popped;
-          auto outdated =
-            epoch == T::NO_EPOCH_SET || GlobalEpoch::is_outdated(epoch);
-          if (outdated)
+          *p = c->next_dead;
+          remove_from_list(c);
+          Logging::cout() << "Stub collected cown " << c << Logging::endl;
+          c->dealloc(*alloc);
+          count++;
+          continue;
+        }
+
+        Logging::cout() << "Cown " << c << " not outdated." << Logging::endl;
+        p = &(c->next_dead);
+      }
+
+      dead_pending_count -= count;
+      free_cowns -= count;
+    }
+
+    /**
+     * At teardown, frees the stubs of all cowns in `list`, whether they have
+     * died or not.  If detecting leaks, the cowns that are still referenced
+     * are reported and left allocated.
+     */
+    void collect_all_cown_stubs()
+    {
+      T* c = list;
+      size_t count = 0;
+
+      while (c != nullptr)
+      {
+        T* n = c->next;
+        if (c->weak_count != 0)
+        {
+          Logging::cout() << "Leaking cown " << c << Logging::endl;
+          if (Scheduler::get_detect_leaks())
           {
-            count++;
-            *p = c->next;
-            Logging::cout() << "Stub collected cown " << c << Logging::endl;
-            c->dealloc(*alloc);
+            remove_from_list(c);
+            c = n;
             continue;
           }
-          else
-          {
-            if (!outdated)
-              Logging::cout()
-                << "Cown " << c << " not outdated." << Logging::endl;
-          }
         }
-        p = &(c->next);
+
+        Logging::cout() << "Stub collect cown " << c << Logging::endl;
+        if (stub_outdated(c))
+        {
+          count++;
+          remove_from_list(c);
+          Logging::cout() << "Stub collected cown " << c << Logging::endl;
+          c->dealloc(*alloc);
+        }
+        else
+        {
+          Logging::cout() << "Cown " << c << " not outdated." << Logging::endl;
+        }
+        c = n;
       }
 
+      dead.store(nullptr, std::memory_order_relaxed);
+      dead_pending = nullptr;
+      dead_pending_count = 0;
       free_cowns -= count;
     }
   };
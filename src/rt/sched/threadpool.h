@@ -3,17 +3,23 @@
 #pragma once
 
 #include "../pal/threadpoolbuilder.h"
+#include "iopoller.h"
+#include "schedulerstats.h"
 #include "test/logging.h"
 #include "threadstate.h"
+#include "timerwheel.h"
 #ifdef USE_SYSTEMATIC_TESTING
 #  include "threadsyncsystematic.h"
 #else
 #  include "threadsync.h"
 #endif
 
+#include <algorithm>
+#include <climits>
 #include <condition_variable>
 #include <mutex>
 #include <snmalloc/snmalloc.h>
+#include <vector>
 
 namespace verona::rt
 {
@@ -31,6 +37,10 @@ namespace verona::rt
     static constexpr uint64_t TSC_PAUSE_SLOP = 1'000'000;
     static constexpr uint64_t TSC_UNPAUSE_SLOP = TSC_PAUSE_SLOP / 2;
 
+    /// Default bounds on how long an idle thread spins before parking.
+    static constexpr uint64_t TSC_SPIN_MIN = 100'000;
+    static constexpr uint64_t TSC_SPIN_MAX = 20'000'000;
+
     bool detect_leaks = true;
     size_t incarnation = 1;
 
@@ -50,8 +60,9 @@ namespace verona::rt
 
     /**
      * Used to track unpause calls.  Threads unpausing
-     * attempt to catch unpause_epoch up to pause_epoch,
-     * and thus ensure threads are running.
+     * attempt to move unpause_epoch towards pause_epoch,
+     * and thus ensure threads are running.  Each step of
+     * unpause_epoch wakes at most one paused thread.
      */
     std::atomic<uint64_t> unpause_epoch{0};
 
@@ -78,8 +89,30 @@ namespace verona::rt
 
     bool teardown_in_progress = false;
 
+    /// File descriptors watched by cowns.
+    IOPoller io;
+
+    /// Timers waiting to fire.
+    TimerWheel timers;
+
     bool fair = false;
 
+    /// Run behaviours on the sending thread when all their cowns can be
+    /// acquired immediately.
+    bool inline_behaviours = false;
+
+    /// Bounds, in ticks, on how long an idle scheduler thread spins looking
+    /// for work before parking.  Each thread adapts its spin within these.
+    uint64_t spin_min = TSC_SPIN_MIN;
+    uint64_t spin_max = TSC_SPIN_MAX;
+
+    /// Number of cowns a thread must bind since its last leak detector
+    /// cycle before it starts one, or zero to only start them explicitly.
+    size_t ld_cowns = 0;
+    /// Largest percentage of a thread's time between the starts of leak
+    /// detector cycles that automatically started cycles may take.
+    size_t ld_max_overhead = 10;
+
     ThreadState state;
 
   public:
@@ -103,7 +136,8 @@ namespace verona::rt
     {
       Logging::cout() << "Increase inflight count: " << get().inflight_count + 1
                       << Logging::endl;
-      local()->scheduled_unscanned_cown = true;
+      if (local() != nullptr)
+        local()->scheduled_unscanned_cown = true;
       get().inflight_count++;
     }
 
@@ -162,6 +196,54 @@ namespace verona::rt
                       << (prev_count - 1) << ")" << Logging::endl;
     }
 
+    /// Returns the file descriptors watched by cowns, see `Cown::watch_io`.
+    static IOPoller& io_poller()
+    {
+      return get().io;
+    }
+
+    /**
+     * Returns the pending timers.  While there are any, they count as one
+     * external event source, see `add_timer`.
+     */
+    static TimerWheel& timer_wheel()
+    {
+      return get().timers;
+    }
+
+    /**
+     * Adds `t` to the pending timers.  If this thread is scanning for the
+     * leak detector, what `t` refers to is scanned first, as the scan of the
+     * pending timers may already have been done.  Once added, `t` may fire
+     * and be freed on another thread.
+     *
+     * The wheel counts as an external event source from when a timer is
+     * added to it while empty, until it is next emptied and the timers that
+     * emptied it have fired, so that the runtime does not stop before they
+     * have scheduled their work.
+     *
+     * Must be called from a scheduler thread.
+     */
+    static void add_timer(Timer* t)
+    {
+      if ((t->trace != nullptr) && should_scan())
+        local()->scan_timer(t);
+      get().timers.add(t, []() { add_external_event_source(); });
+    }
+
+    /**
+     * Removes `t` from the pending timers, unless it has already been taken
+     * to fire.  Returns true if it was removed, in which case it will not
+     * fire, and the caller is responsible for freeing it.
+     *
+     * Must be called from a scheduler thread.
+     */
+    static bool cancel_timer(Timer* t)
+    {
+      return get().timers.remove(
+        t, []() { remove_external_event_source(); });
+    }
+
     static void set_fair(bool fair)
     {
       Logging::cout() << "Set fair: " << fair << Logging::endl;
@@ -169,6 +251,86 @@ namespace verona::rt
       s.fair = fair;
     }
 
+    /**
+     * If set, a behaviour whose cowns are all acquired immediately when it
+     * is scheduled from a scheduler thread, is run straight away on that
+     * thread, rather than going through the scheduler queue.  This reduces
+     * the latency of short behaviours on several cowns.  Running inline is
+     * bounded in nesting and time, after which behaviours are scheduled as
+     * normal.
+     */
+    static void set_inline_behaviours(bool b)
+    {
+      Logging::cout() << "Set inline behaviours: " << b << Logging::endl;
+      get().inline_behaviours = b;
+    }
+
+    static bool get_inline_behaviours()
+    {
+      return get().inline_behaviours;
+    }
+
+    /**
+     * Sets the bounds, in ticks, on how long an idle scheduler thread spins
+     * looking for work before it parks.  Each thread adapts its spin between
+     * these bounds from how often spinning finds work and how soon it is
+     * woken after parking.  Setting both to the same value gives a fixed spin.
+     *
+     * This should be called before the runtime is started.
+     */
+    static void set_spin_bounds(uint64_t min, uint64_t max)
+    {
+      Logging::cout() << "Set spin bounds: " << min << " - " << max
+                      << Logging::endl;
+      assert(min <= max);
+      auto& s = get();
+      s.spin_min = min;
+      s.spin_max = max;
+    }
+
+    /**
+     * Starts leak detector cycles automatically.  A scheduler thread starts
+     * one once `cowns` new cowns have been bound to it since its last cycle,
+     * unless the last cycle took more than `max_overhead` percent of the time
+     * since it started.  Under load, cycles are spaced out so that they take
+     * a bounded share of each thread's time.  `cowns` of zero turns this
+     * off, which is the default.
+     *
+     * This should be called before the runtime is started.
+     */
+    static void set_ld_trigger(size_t cowns, size_t max_overhead = 10)
+    {
+      Logging::cout() << "Set LD trigger: " << cowns << " cowns, "
+                      << max_overhead << "%" << Logging::endl;
+      assert((max_overhead > 0) && (max_overhead <= 100));
+      auto& s = get();
+      s.ld_cowns = cowns;
+      s.ld_max_overhead = max_overhead;
+    }
+
+    /**
+     * Takes a snapshot of the statistics of every scheduler thread.  This can
+     * be called from any thread while the runtime is running, and does not
+     * stop the scheduler threads, so the counters of different threads are
+     * not read at the same instant.
+     */
+    static std::vector<SchedulerStatsSnapshot> snapshot_stats()
+    {
+      std::vector<SchedulerStatsSnapshot> result;
+      T* first = get().first_thread;
+      if (first == nullptr)
+        return result;
+
+      T* t = first;
+      do
+      {
+        result.push_back(t->snapshot_stats());
+        t = t->next;
+      } while (t != first);
+
+      return result;
+    }
+
     static bool is_teardown_in_progress()
     {
       return get().teardown_in_progress;
@@ -180,6 +342,19 @@ namespace verona::rt
       return local;
     }
 
+    /**
+     * Returns the scheduler thread at position `index` in the ring of
+     * threads.  The runtime must have been initialised.
+     */
+    static T* get_thread(size_t index)
+    {
+      assert(index < get().thread_count);
+      T* t = get().first_thread;
+      for (size_t i = 0; i < index; i++)
+        t = t->next;
+      return t;
+    }
+
     static T* round_robin()
     {
       static thread_local size_t incarnation;
@@ -332,6 +507,16 @@ namespace verona::rt
     {
       active_thread_count = thread_count;
       T* t = first_thread;
+
+      // Threads are pinned in ring order, so the position in the ring
+      // determines the locality of each thread's victims.
+      size_t index = 0;
+      do
+      {
+        t->init_victims(index++, thread_count);
+        t = t->next;
+      } while (t != first_thread);
+
       {
         ThreadPoolBuilder builder(thread_count);
 
@@ -361,6 +546,7 @@ namespace verona::rt
       thread_count = 0;
       active_thread_count = 0;
       state.reset<ThreadState::NotInLD>();
+      io.close();
 
       Epoch::flush(ThreadAlloc::get());
     }
@@ -378,13 +564,18 @@ namespace verona::rt
 
     bool check_for_work()
     {
-      // TODO: check for pending async IO
+      if (local()->poll_io(0) || local()->fire_timers())
+      {
+        Logging::cout() << "Found pending I/O or timers!" << Logging::endl;
+        return true;
+      }
+
       T* t = first_thread;
       do
       {
         Logging::cout() << "Checking for pending work on thread "
                         << t->systematic_id << Logging::endl;
-        if (!t->q.nothing_old())
+        if (!t->nothing_old())
         {
           Logging::cout() << "Found pending work!" << Logging::endl;
           return true;
@@ -422,6 +613,7 @@ namespace verona::rt
 
       yield();
 
+      bool wait_io = false;
       {
         auto h = sync.handle(local());
 
@@ -441,39 +633,122 @@ namespace verona::rt
           return true;
         }
 
+        // Watched file descriptors and timers are external sources that this
+        // thread can wait on itself, once it has released the lock.
+        if (io.has_watches() || timers.has_pending())
+        {
+          wait_io = true;
+        }
         // There are external sources should wait for external wake ups.
-        if (external_event_sources != 0)
+        // As only one thread may be woken, this must also be counted, so
+        // that whichever thread wakes can become the last thread.
+        else if (external_event_sources != 0)
         {
+          active_thread_count--;
           Logging::cout() << "Pausing last thread" << Logging::endl;
           h.pause(); // Spurious wake-ups are safe.
           Logging::cout() << "Unpausing last thread" << Logging::endl;
+          active_thread_count++;
           return true;
         }
-
-        Logging::cout() << "Teardown beginning" << Logging::endl;
-        // Used to handle deallocating all the state of the threads.
-        teardown_in_progress = true;
-
-        // Tell all threads to stop looking for work.
-        T* t = first_thread;
-        do
+        else
         {
-          t->stop();
-          t = t->next;
-        } while (t != first_thread);
-        Logging::cout() << "Teardown: all threads stopped" << Logging::endl;
+          Logging::cout() << "Teardown beginning" << Logging::endl;
+          // Used to handle deallocating all the state of the threads.
+          teardown_in_progress = true;
 
-        h.unpause_all();
-        Logging::cout() << "cv_notify_all() for teardown" << Logging::endl;
+          // Tell all threads to stop looking for work.
+          T* t = first_thread;
+          do
+          {
+            t->stop();
+            t = t->next;
+          } while (t != first_thread);
+          Logging::cout() << "Teardown: all threads stopped" << Logging::endl;
+
+          h.unpause_all();
+          Logging::cout() << "cv_notify_all() for teardown" << Logging::endl;
+        }
       }
+
+      if (wait_io)
+        return wait_for_io(local_unpause_epoch);
+
       Logging::cout() << "Teardown: all threads beginning teardown"
                       << Logging::endl;
       return true;
     }
 
+    /**
+     * Called instead of pausing by the last running thread, while file
+     * descriptors are watched or timers are pending.  Blocks polling the
+     * descriptors, until one is ready, the next timer is due, or an unpause
+     * wakes this thread through the poller.  This thread stays counted as
+     * active, so other threads pause as normal.
+     *
+     * With systematic testing, threads cannot block outside the systematic
+     * scheduler, so this only polls, and the thread keeps looking for work.
+     */
+    bool wait_for_io(uint64_t local_unpause_epoch)
+    {
+#ifdef USE_SYSTEMATIC_TESTING
+      UNUSED(local_unpause_epoch);
+      local()->poll_io(0);
+      local()->fire_timers();
+      return false;
+#else
+      // Without a poller, keep looking for work.
+      if (!io.open())
+        return false;
+
+      // This must be visible before checking for a racing unpause, which
+      // checks it after moving the unpause epoch on.
+      io.set_waiting(true);
+      if (local_unpause_epoch == unpause_epoch.load(std::memory_order_seq_cst))
+      {
+        int timeout_ms = -1;
+        uint64_t deadline = timers.next_deadline();
+        if (deadline != UINT64_MAX)
+        {
+          uint64_t now = TimerWheel::now();
+          uint64_t wait = (deadline > now) ? deadline - now : 0;
+          timeout_ms = (int)std::min<uint64_t>(
+            (wait + TimerWheel::RESOLUTION - 1) / TimerWheel::RESOLUTION,
+            INT_MAX);
+        }
+
+        Logging::cout() << "Waiting for I/O for " << timeout_ms << "ms"
+                        << Logging::endl;
+        local()->poll_io(timeout_ms);
+        Logging::cout() << "Finished waiting for I/O" << Logging::endl;
+      }
+      io.set_waiting(false);
+      local()->fire_timers();
+      return true;
+#endif
+    }
+
+    /**
+     * Wakes a single paused thread, if there are any.  Used when work is
+     * added, so that threads are woken as work arrives.
+     */
     bool unpause()
     {
-      Logging::cout() << "unpause()" << Logging::endl;
+      return unpause_inner(false);
+    }
+
+    /**
+     * Wakes all paused threads.  Used when every thread must observe a
+     * change, such as the start of the LD protocol.
+     */
+    bool unpause_all()
+    {
+      return unpause_inner(true);
+    }
+
+    bool unpause_inner(bool all)
+    {
+      Logging::cout() << "unpause(" << all << ")" << Logging::endl;
 
       // Work should be added before checking for the runtime_pause.
       Barrier::compiler();
@@ -498,13 +773,21 @@ namespace verona::rt
 
       yield();
 
-      // Attempt to catch up epoch.
+      // Attempt to move the epoch on by one, so that this call wakes a
+      // single thread.  Any thread that is part way through pausing will
+      // observe the change and not sleep.  Further calls will wake further
+      // threads, so threads are only woken as work arrives, rather than all
+      // at once.  Waking all threads catches up the epoch.
       bool success = unpause_epoch.compare_exchange_strong(
-        local_unpause_epoch, local_pause_epoch);
+        local_unpause_epoch, all ? local_pause_epoch : local_unpause_epoch + 1);
 
       yield();
 
+      // A thread waiting for I/O is not paused, so is woken separately.
       if (success)
+        io.wake_waiter();
+
+      if (success && all)
       {
         // This grabs the scheduler lock to ensure threads have seen CAS before
         // we notify.
@@ -512,6 +795,24 @@ namespace verona::rt
         sync.unpause_all(local());
         return true;
       }
+
+      if (success)
+      {
+        // This grabs the scheduler lock to ensure threads have seen CAS before
+        // we notify.
+        Logging::cout() << "Wake one thread" << Logging::endl;
+        if (!sync.unpause_one(local()))
+        {
+          // No thread was asleep, the remaining difference is from threads
+          // that started to pause, but found work.  Catch up the epoch, so
+          // that later calls can exit early.
+          Logging::cout() << "No thread to wake" << Logging::endl;
+          local_unpause_epoch++;
+          unpause_epoch.compare_exchange_strong(
+            local_unpause_epoch, local_pause_epoch);
+        }
+        return true;
+      }
       // Another thread won the CAS race, and is responsible for waking up.
       return false;
     }
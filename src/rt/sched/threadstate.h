@@ -168,7 +168,16 @@ namespace verona::rt
               return vote<Scan, AllInScan>(total_votes);
 
             case Scan:
+            {
+              // With a single thread, no thread is left in PreScan to vote
+              // the global state on to AllInScan.
+              if (total_votes == 1)
+              {
+                reset<AllInScan>();
+                return AllInScan;
+              }
               return Scan;
+            }
 
             default:
               abort();
@@ -26,6 +26,9 @@ namespace verona::rt
    *    has attempted to lock for unpause. Rather than waiting for the lock to
    *    become available, the thread currently holding the lock takes
    *    responsibility for unpausing the other threads.
+   *
+   * What to unpause is recorded by the caller before `lock_for_unpause`, so
+   * the thread holding the lock can find it.
    */
   class SchedulerLock
   {
@@ -71,12 +74,14 @@ namespace verona::rt
     }
 
     /**
-     * Releases the lock ignoring any unpause requests.
+     * Takes responsibility for the pending unpause requests, while continuing
+     * to hold the lock.  Requests made after this will cause the next
+     * `unlock` to fail again.
      */
-    void unlock_unpause()
+    void clear_unpause()
     {
       assert(state.load(std::memory_order_relaxed) == LockedUnpauseNeeded);
-      state.store(Unlocked);
+      state.store(Locked);
     }
 
     /**
@@ -102,39 +107,106 @@ namespace verona::rt
     SchedulerLock lock;
     LocalSync* waiters = nullptr;
 
-    void unlock()
+    /// Number of waiters requested to be woken by `unpause_one`.
+    std::atomic<size_t> pending_wakes{0};
+    /// Set if all waiters have been requested to be woken.
+    std::atomic<bool> pending_wake_all{false};
+
+    /**
+     * Removes the waiters that pending requests are for from the list, and
+     * adds them to `woken`.  Returns true if any requested wake could not be
+     * matched with a waiter.
+     */
+    bool take_pending(LocalSync*& woken)
     {
-      Logging::cout() << "Unlock Scheduler lock" << Logging::endl;
+      bool unmatched = false;
 
-      // Releasing the lock can pickup an unpause request
-      if (!lock.unlock())
+      if (pending_wake_all.exchange(false))
       {
-        Logging::cout() << "Pending unpause" << Logging::endl;
+        pending_wakes.store(0);
+        while (waiters != nullptr)
+        {
+          auto next = waiters->next;
+          waiters->next = woken;
+          woken = waiters;
+          waiters = next;
+        }
+        return false;
+      }
 
-        auto* curr = waiters;
-        waiters = nullptr;
-        // Subsequent unpause requests can be ignored as there are no more
-        // waiters as we have held the lock continuously.
-        lock.unlock_unpause();
-        // Don't need to hold the lock to wake up the waiters.
-        while (curr != nullptr)
+      for (size_t n = pending_wakes.exchange(0); n > 0; n--)
+      {
+        if (waiters == nullptr)
         {
-          auto next = curr->next;
-          curr->sem.wake();
-          curr = next;
+          unmatched = true;
+          break;
         }
+        auto next = waiters->next;
+        waiters->next = woken;
+        woken = waiters;
+        waiters = next;
+      }
+
+      return unmatched;
+    }
+
+    /**
+     * Releases the lock.  Returns true if an unpause request was made while
+     * the lock was held, that did not find a waiter to wake.
+     */
+    bool unlock()
+    {
+      Logging::cout() << "Unlock Scheduler lock" << Logging::endl;
+
+      LocalSync* woken = nullptr;
+      bool unmatched = false;
+
+      // Releasing the lock can pickup an unpause request.  Keep handling
+      // requests until the lock is released, so that none are lost.
+      while (!lock.unlock())
+      {
+        Logging::cout() << "Pending unpause" << Logging::endl;
+        lock.clear_unpause();
+        unmatched |= take_pending(woken);
+      }
+
+      // Don't need to hold the lock to wake up the waiters.
+      while (woken != nullptr)
+      {
+        auto next = woken->next;
+        woken->sem.wake();
+        woken = next;
       }
+
+      return unmatched;
     }
 
   public:
     void unpause_all(T*)
     {
       Logging::cout() << "Unpause all" << Logging::endl;
+      pending_wake_all = true;
       if (lock.lock_for_unpause())
         unlock();
       Logging::cout() << "Unpause all done" << Logging::endl;
     }
 
+    /**
+     * Wake a single paused thread.
+     *
+     * Returns false if it is known that there was no paused thread to wake.
+     * If the request is handed to another thread holding the lock, this
+     * optimistically returns true.
+     */
+    bool unpause_one(T*)
+    {
+      Logging::cout() << "Unpause one" << Logging::endl;
+      pending_wakes++;
+      if (lock.lock_for_unpause())
+        return !unlock();
+      return true;
+    }
+
     class ThreadSyncHandle
     {
       T* thread;
@@ -183,6 +255,7 @@ namespace verona::rt
         {
           // Set to the unpause state. We already hold the lock, so we
           // know that it will return false.
+          sync.pending_wake_all = true;
           sync.lock.lock_for_unpause();
         }
         sync.unlock();
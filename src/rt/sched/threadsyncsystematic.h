@@ -27,6 +27,13 @@ namespace verona::rt
     /// ignore.
     size_t unpause_incarnation = 0;
 
+    /// Number of threads currently paused.
+    size_t waiters = 0;
+
+    /// Number of paused threads that have been chosen to be woken by
+    /// `unpause_one`, but have not yet woken.
+    size_t pending_wakes = 0;
+
     void acquire()
     {
       auto guard = [&]() { return !m; };
@@ -63,11 +70,16 @@ namespace verona::rt
         // Copy for capture by value
         auto sync_ptr = &sync;
         auto guard = [incarnation, sync_ptr]() {
-          return incarnation != sync_ptr->unpause_incarnation;
+          return (incarnation != sync_ptr->unpause_incarnation) ||
+            (sync_ptr->pending_wakes > 0);
         };
-        // Guard should not hold here.
-        assert(!guard());
+        sync.waiters++;
         Systematic::yield_until(guard);
+        // Execution is sequentialised, so no other thread can have taken
+        // the wake since the guard was checked.
+        sync.waiters--;
+        if (incarnation == sync.unpause_incarnation)
+          sync.pending_wakes--;
 
         sync.acquire();
       }
@@ -84,6 +96,7 @@ namespace verona::rt
           // Treat as a yield pointer if thread is under systematic testing
           // control.
           sync.unpause_incarnation++;
+          sync.pending_wakes = 0;
           Systematic::yield();
         }
       }
@@ -109,5 +122,18 @@ namespace verona::rt
     {
       handle(me).unpause_all();
     }
+
+    /**
+     * This unpauses a single thread.  Returns false if there was no paused
+     * thread to wake.
+     */
+    bool unpause_one(T* me)
+    {
+      auto h = handle(me);
+      if (waiters == pending_wakes)
+        return false;
+      pending_wakes++;
+      return true;
+    }
   };
 }
@@ -0,0 +1,345 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "object/object.h"
+#include "test/logging.h"
+#include "test/systematic.h"
+
+#include <atomic>
+#include <chrono>
+#include <snmalloc/snmalloc.h>
+
+namespace verona::rt
+{
+  /**
+   * An entry in a `TimerWheel`.  `fire` is called once the steady clock has
+   * reached `deadline`, in nanoseconds, after the timer has been removed
+   * from the wheel.  It is responsible for freeing the timer.
+   *
+   * `trace`, if set, pushes the cowns that `fire` will use.  Nothing else may
+   * refer to them while the timer is pending, so the leak detector scans
+   * them, see `TimerWheel::trace`.
+   *
+   * While the timer is in the wheel, `prev` is the link that points to it,
+   * so that it can be removed from its slot, see `TimerWheel::remove`.
+   */
+  struct Timer
+  {
+    using TraceFunction = void (*)(const Timer*, ObjectStack&);
+
+    uint64_t deadline;
+    void (*fire)(Timer*);
+    TraceFunction trace;
+    Timer* next = nullptr;
+    Timer** prev = nullptr;
+
+    Timer(
+      uint64_t deadline, void (*fire)(Timer*), TraceFunction trace = nullptr)
+    : deadline(deadline), fire(fire), trace(trace)
+    {}
+  };
+
+  /**
+   * The pending timers, shared by all scheduler threads.
+   *
+   * This is a hierarchical timing wheel of `LEVELS` levels of `SLOTS` slots.
+   * The slots of level `i` each span `SLOTS^i` ticks of `RESOLUTION`, so
+   * adding a timer is constant time, and only the timers in the slot of the
+   * current tick are looked at as time passes.  Each time the lower level
+   * wraps, the timers of the next slot of the level above are spread out
+   * over the lower levels.  Timers beyond the range of the wheel are put in
+   * its last slot, and placed again when that is spread out.
+   *
+   * Scheduler threads advance the wheel as part of their loop, and fire the
+   * timers that are due themselves.  Checking the wheel is a load of
+   * `next_due`, and reading the clock if there are timers pending.  Only one
+   * thread advances the wheel and fires the timers that were due at a time,
+   * and other threads skip it rather than wait.  So timers fire in the order
+   * of the ticks they are due in, though timers due in the same tick may
+   * fire in any order.  A timer never fires before its deadline, and fires
+   * within a tick of it if a thread is looking for work.
+   */
+  class TimerWheel
+  {
+  public:
+    /// Length of a tick of the wheel in nanoseconds.
+    static constexpr uint64_t RESOLUTION = 1'000'000;
+
+  private:
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = 1 << SLOT_BITS;
+    static constexpr uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr size_t LEVELS = 4;
+    /// Number of ticks covered by the wheel.
+    static constexpr uint64_t RANGE = (uint64_t)1 << (SLOT_BITS * LEVELS);
+    static constexpr uint64_t NONE = UINT64_MAX;
+
+    Timer* slots[LEVELS][SLOTS] = {};
+
+    /// The tick up to which timers have been fired.
+    uint64_t current = 0;
+
+    /// Number of timers in the wheel.
+    std::atomic<size_t> pending{0};
+
+    /// A tick no later than the earliest that a timer in the wheel is due,
+    /// or NONE if there are no timers.
+    std::atomic<uint64_t> next_due{NONE};
+
+    /// Held while the wheel is changed.
+    std::atomic<bool> busy{false};
+
+    /// Held by the thread advancing the wheel, until it has fired the timers
+    /// that were due.
+    std::atomic<bool> firing{false};
+
+    bool try_lock()
+    {
+      return !busy.exchange(true, std::memory_order_acquire);
+    }
+
+    void lock()
+    {
+      while (!try_lock())
+      {
+        snmalloc::Aal::pause();
+        Systematic::yield();
+      }
+    }
+
+    void unlock()
+    {
+      busy.store(false, std::memory_order_release);
+    }
+
+    /// Returns the tick at which a timer with `deadline` is due.
+    static uint64_t due_tick(uint64_t deadline)
+    {
+      return (deadline + RESOLUTION - 1) / RESOLUTION;
+    }
+
+    void insert(Timer* t)
+    {
+      uint64_t tick = due_tick(t->deadline);
+      if (tick <= current)
+        tick = current + 1;
+      else if (tick - current >= RANGE)
+        tick = current + RANGE - 1;
+
+      // Use the lowest level whose slots are small enough that the timer
+      // is not due within the current slot of the level above.
+      uint64_t delta = tick - current;
+      size_t level = 0;
+      while ((level < LEVELS - 1) && (delta >> (SLOT_BITS * (level + 1))) != 0)
+        level++;
+
+      auto& slot = slots[level][(tick >> (SLOT_BITS * level)) & SLOT_MASK];
+      t->next = slot;
+      t->prev = &slot;
+      if (slot != nullptr)
+        slot->prev = &t->next;
+      slot = t;
+    }
+
+    /// Spreads out the timers in the slot of `level` for the current tick.
+    void cascade(size_t level)
+    {
+      auto& slot = slots[level][(current >> (SLOT_BITS * level)) & SLOT_MASK];
+      Timer* t = slot;
+      slot = nullptr;
+      while (t != nullptr)
+      {
+        Timer* next = t->next;
+        insert(t);
+        t = next;
+      }
+    }
+
+    /**
+     * Returns a tick no later than the earliest that a timer in the wheel is
+     * due.  This is either the tick of the next timer in the lowest level,
+     * or, if there is none before it wraps, the tick when it wraps.
+     */
+    uint64_t find_next_due()
+    {
+      if (pending.load(std::memory_order_relaxed) == 0)
+        return NONE;
+
+      uint64_t wrap = (current | SLOT_MASK) + 1;
+      for (uint64_t tick = current + 1; tick < wrap; tick++)
+      {
+        if (slots[0][tick & SLOT_MASK] != nullptr)
+          return tick;
+      }
+      return wrap;
+    }
+
+  public:
+    constexpr TimerWheel() = default;
+
+    /// Returns the time on the steady clock, in nanoseconds.
+    static uint64_t now()
+    {
+      return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+    }
+
+    bool has_pending()
+    {
+      return next_due.load(std::memory_order_acquire) != NONE;
+    }
+
+    /// Returns a time no later than the deadline of the earliest timer, or
+    /// UINT64_MAX if there are none.
+    uint64_t next_deadline()
+    {
+      auto due = next_due.load(std::memory_order_acquire);
+      return (due == NONE) ? UINT64_MAX : due * RESOLUTION;
+    }
+
+    /**
+     * Adds `t` to the wheel.  If the wheel was empty, `on_busy` is called
+     * before the wheel is unlocked, so before `t` can fire.
+     */
+    template<typename F>
+    void add(Timer* t, F&& on_busy)
+    {
+      Logging::cout() << "Add timer " << t << " for " << t->deadline
+                      << Logging::endl;
+
+      lock();
+      // The wheel is empty, so can skip straight to the current time.
+      if (pending.load(std::memory_order_relaxed) == 0)
+      {
+        current = now() / RESOLUTION;
+        on_busy();
+      }
+      insert(t);
+      pending.fetch_add(1, std::memory_order_relaxed);
+      next_due.store(find_next_due(), std::memory_order_release);
+      unlock();
+    }
+
+    /**
+     * Removes `t` from the wheel, if it has not already been removed to be
+     * fired.  Returns true if it was removed, in which case it will not fire,
+     * and the caller is responsible for freeing it.  If this empties the
+     * wheel, `on_idle` is called once the wheel is unlocked.
+     */
+    template<typename F>
+    bool remove(Timer* t, F&& on_idle)
+    {
+      lock();
+      if (t->prev == nullptr)
+      {
+        unlock();
+        return false;
+      }
+
+      *t->prev = t->next;
+      if (t->next != nullptr)
+        t->next->prev = t->prev;
+      t->next = nullptr;
+      t->prev = nullptr;
+      bool idle = pending.fetch_sub(1, std::memory_order_relaxed) == 1;
+      next_due.store(find_next_due(), std::memory_order_release);
+      unlock();
+
+      Logging::cout() << "Remove timer " << t << Logging::endl;
+      if (idle)
+        on_idle();
+      return true;
+    }
+
+    /// Calls the trace function of each pending timer that has one.
+    void trace(ObjectStack& st)
+    {
+      if (pending.load(std::memory_order_acquire) == 0)
+        return;
+
+      lock();
+      for (auto& level : slots)
+      {
+        for (Timer* t : level)
+        {
+          for (; t != nullptr; t = t->next)
+          {
+            if (t->trace != nullptr)
+              t->trace(t, st);
+          }
+        }
+      }
+      unlock();
+    }
+
+    /**
+     * Removes the timers that are due from the wheel, and calls `f` on each
+     * of them.  Returns immediately if another thread is advancing the wheel,
+     * or is still firing the timers it found due.
+     * Returns the number of timers that were due.  If this empties the wheel,
+     * `on_idle` is called once all of them have been fired.
+     */
+    template<typename F, typename G>
+    size_t advance(F&& f, G&& on_idle)
+    {
+      auto due = next_due.load(std::memory_order_acquire);
+      if ((due == NONE) || (now() / RESOLUTION < due))
+        return 0;
+
+      if (firing.exchange(true, std::memory_order_acquire))
+        return 0;
+
+      lock();
+      uint64_t until = now() / RESOLUTION;
+      Timer* fired = nullptr;
+      Timer** fired_tail = &fired;
+      size_t count = 0;
+      while ((current < until) && (pending.load(std::memory_order_relaxed) > 0))
+      {
+        current++;
+
+        // Spread out the levels that have wrapped, highest first.
+        for (size_t level = LEVELS - 1; level > 0; level--)
+        {
+          uint64_t below = ((uint64_t)1 << (SLOT_BITS * level)) - 1;
+          if ((current & below) == 0)
+            cascade(level);
+        }
+
+        auto& slot = slots[0][current & SLOT_MASK];
+        *fired_tail = slot;
+        slot = nullptr;
+        while (*fired_tail != nullptr)
+        {
+          (*fired_tail)->prev = nullptr;
+          fired_tail = &(*fired_tail)->next;
+          count++;
+          pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+      }
+
+      bool empty = pending.load(std::memory_order_relaxed) == 0;
+      if (empty)
+        current = until;
+      // The wheel may have been emptied by `remove` instead.
+      bool idle = empty && (count != 0);
+      next_due.store(find_next_due(), std::memory_order_release);
+      unlock();
+
+      while (fired != nullptr)
+      {
+        Timer* t = fired;
+        fired = t->next;
+        Logging::cout() << "Fire timer " << t << Logging::endl;
+        f(t);
+      }
+      firing.store(false, std::memory_order_release);
+
+      if (idle)
+        on_idle();
+      return count;
+    }
+  };
+} // namespace verona::rt
@@ -1,6 +1,7 @@
 // Copyright Microsoft and Project Verona Contributors.
 // SPDX-License-Identifier: MIT
 #include "deadlock.h"
+#include "fanin.h"
 #include "unblock.h"
 
 #include <test/harness.h>
@@ -10,5 +11,6 @@ int main(int argc, char** argv)
   SystematicTestHarness harness(argc, argv);
   harness.run(backpressure_deadlock::test);
   harness.run(backpressure_unblock::test);
+  harness.run(backpressure_fanin::test);
   return 0;
 }
@@ -0,0 +1,74 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * This test creates many senders that each send a fixed number of messages to
+ * a receiver, through a chain of proxies.  The receiver processes one message
+ * per batch, so it is overloaded, and the proxies and senders are muted.  All
+ * messages must still be delivered, and every muted cown must be unmuted.
+ */
+
+#include "../../../verona.h"
+
+namespace backpressure_fanin
+{
+  using namespace verona::rt;
+
+  static constexpr size_t SENDERS = 20;
+  static constexpr size_t MESSAGES = 50;
+  static constexpr size_t PROXIES = 2;
+
+  struct Receiver : public VCown<Receiver>
+  {
+    size_t received = 0;
+  };
+
+  struct Node : public VCown<Node>
+  {};
+
+  static Receiver* receiver;
+  static Node* proxies[PROXIES];
+
+  void forward(size_t index)
+  {
+    if (index == PROXIES)
+    {
+      schedule_lambda(receiver, [] {
+        receiver->received++;
+        if (receiver->received == SENDERS * MESSAGES)
+        {
+          auto& alloc = ThreadAlloc::get();
+          for (auto* p : proxies)
+            Cown::release(alloc, p);
+          Cown::release(alloc, receiver);
+        }
+      });
+      return;
+    }
+
+    schedule_lambda(proxies[index], [index] { forward(index + 1); });
+  }
+
+  void send(Node* sender, size_t remaining)
+  {
+    schedule_lambda(sender, [sender, remaining] {
+      forward(0);
+      if (remaining > 1)
+        send(sender, remaining - 1);
+      else
+        Cown::release(ThreadAlloc::get(), sender);
+    });
+  }
+
+  void test()
+  {
+    auto& alloc = ThreadAlloc::get();
+    receiver = new (alloc) Receiver;
+    receiver->set_batch_limit(BatchLimit::messages(1));
+    for (auto*& p : proxies)
+      p = new (alloc) Node;
+
+    for (size_t i = 0; i < SENDERS; i++)
+      send(new (alloc) Node, MESSAGES);
+  }
+}
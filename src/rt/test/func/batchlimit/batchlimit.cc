@@ -0,0 +1,92 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+static constexpr size_t MESSAGES = 40;
+
+struct Small : public VCown<Small>
+{
+  size_t count = 0;
+
+  static BatchLimit batch_limit()
+  {
+    return BatchLimit::messages(2);
+  }
+};
+
+struct Plain : public VCown<Plain>
+{
+  size_t count = 0;
+};
+
+void test_count()
+{
+  auto* c = new Small;
+
+  // Send all the messages while the cown is running, so they are all queued
+  // when it next runs.
+  schedule_lambda(c, [c]() {
+    for (size_t i = 0; i < MESSAGES; i++)
+    {
+      schedule_lambda(c, [c]() {
+        c->count++;
+
+        if (c->count < MESSAGES)
+          return;
+
+        // Only this cown has run, and it never runs more than two messages
+        // at a time.
+        SchedulerStatsSnapshot total;
+        for (auto& s : Scheduler::snapshot_stats())
+          total.add(s);
+
+        for (size_t b = SchedulerStatsSnapshot::batch_bucket(4);
+             b < SchedulerStatsSnapshot::BATCH_BUCKETS;
+             b++)
+          check(total.batch_sizes[b] == 0);
+        check(total.batch_limit_hits > 0);
+      });
+    }
+  });
+
+  Cown::release(ThreadAlloc::get(), c);
+}
+
+void test_mode(BatchLimit limit)
+{
+  auto* c = new Plain;
+  c->set_batch_limit(limit);
+
+  for (size_t i = 0; i < MESSAGES; i++)
+  {
+    schedule_lambda(c, [c]() {
+      c->count++;
+      if (c->count == MESSAGES / 2)
+        c->set_batch_limit(BatchLimit::messages(1));
+    });
+  }
+
+  schedule_lambda(c, [c]() { check(c->count == MESSAGES); });
+
+  Cown::release(ThreadAlloc::get(), c);
+}
+
+void test_time()
+{
+  test_mode(BatchLimit::time_slice(10'000));
+}
+
+void test_adaptive()
+{
+  test_mode(BatchLimit::adaptive(10'000));
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_count);
+  harness.run(test_time);
+  harness.run(test_adaptive);
+  return 0;
+}
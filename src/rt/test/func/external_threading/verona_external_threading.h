@@ -29,6 +29,15 @@ namespace verona::rt
     {
       return index;
     }
+
+    /**
+     * Returns how far apart the CPUs assigned to two scheduler threads are.
+     * Scheduler threads prefer to steal work from closer threads.
+     */
+    size_t distance(size_t, size_t)
+    {
+      return 0;
+    }
   };
 
   namespace cpu
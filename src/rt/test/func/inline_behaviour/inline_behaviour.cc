@@ -0,0 +1,127 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+static constexpr size_t ACCOUNTS = 8;
+static constexpr size_t TRANSFERS = 200;
+static constexpr size_t CHAIN = 1000;
+static constexpr int BALANCE = 100;
+
+struct Account : public VCown<Account>
+{
+  int balance = BALANCE;
+  size_t transfers = 0;
+  // Set while a behaviour on this account is running, to check that a
+  // behaviour run inline never overlaps one that holds the same account.
+  bool busy = false;
+};
+
+void transfer(Account* from, Account* to, int amount)
+{
+  Cown* cowns[2] = {from, to};
+  schedule_lambda(2, cowns, [=]() {
+    check(!from->busy && !to->busy);
+    from->busy = true;
+    to->busy = true;
+
+    from->balance -= amount;
+    to->balance += amount;
+    from->transfers++;
+
+    from->busy = false;
+    to->busy = false;
+  });
+}
+
+void test_transfer()
+{
+  Scheduler::set_inline_behaviours(true);
+
+  Account* accounts[ACCOUNTS];
+  for (size_t i = 0; i < ACCOUNTS; i++)
+    accounts[i] = new Account;
+
+  // Schedule from a behaviour, so the transfers are sent from a scheduler
+  // thread and can run inline.  The accounts are released by the last
+  // behaviour, so they stay alive while the transfers are sent.
+  schedule_lambda([accounts]() {
+    size_t expected = 0;
+    for (size_t i = 0; i < TRANSFERS; i++)
+    {
+      auto* from = accounts[i % ACCOUNTS];
+      auto* to = accounts[(i * 3 + 1) % ACCOUNTS];
+      if (from != to)
+      {
+        transfer(from, to, (int)i % 7);
+        expected++;
+      }
+    }
+
+    Cown* cowns[ACCOUNTS];
+    for (size_t i = 0; i < ACCOUNTS; i++)
+      cowns[i] = accounts[i];
+
+    schedule_lambda(ACCOUNTS, cowns, [accounts, expected]() {
+      int total = 0;
+      size_t transfers = 0;
+      for (size_t i = 0; i < ACCOUNTS; i++)
+      {
+        check(!accounts[i]->busy);
+        total += accounts[i]->balance;
+        transfers += accounts[i]->transfers;
+      }
+      check(total == (int)(ACCOUNTS * BALANCE));
+      check(transfers == expected);
+
+      auto& alloc = ThreadAlloc::get();
+      for (size_t i = 0; i < ACCOUNTS; i++)
+        Cown::release(alloc, accounts[i]);
+    });
+  });
+}
+
+static std::atomic<size_t> chain_steps = 0;
+
+void chain(Account** accounts, size_t remaining)
+{
+  // Each step holds one pair of accounts and schedules the next step on the
+  // next pair, so the next step can be run inline until the chain comes
+  // round to a pair that is still held.  The last step releases the
+  // accounts.
+  size_t pair = 2 * (remaining % (ACCOUNTS / 2));
+  Cown* cowns[2] = {accounts[pair], accounts[pair + 1]};
+  schedule_lambda(2, cowns, [=]() {
+    chain_steps++;
+    if (remaining > 0)
+      chain(accounts, remaining - 1);
+    else
+    {
+      check(chain_steps == CHAIN + 1);
+
+      auto& alloc = ThreadAlloc::get();
+      for (size_t i = 0; i < ACCOUNTS; i++)
+        Cown::release(alloc, accounts[i]);
+    }
+  });
+}
+
+void test_chain()
+{
+  Scheduler::set_inline_behaviours(true);
+  chain_steps = 0;
+
+  static Account* accounts[ACCOUNTS];
+  for (size_t i = 0; i < ACCOUNTS; i++)
+    accounts[i] = new Account;
+
+  schedule_lambda([]() { chain(accounts, CHAIN); });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_transfer);
+  harness.run(test_chain);
+  return 0;
+}
@@ -0,0 +1,86 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+#ifdef __linux__
+#  include <fcntl.h>
+#  include <unistd.h>
+
+static constexpr size_t CHUNKS = 20;
+static constexpr size_t CHUNK_SIZE = 100;
+
+static size_t received = 0;
+
+struct Reader : public VCown<Reader>
+{
+  int fd;
+  bool done = false;
+
+  Reader(int fd) : fd(fd) {}
+
+  void notified(Object* o)
+  {
+    auto* r = (Reader*)o;
+    check(!r->done);
+
+    char buf[64];
+    ssize_t n;
+    while ((n = read(r->fd, buf, sizeof(buf))) > 0)
+      received += (size_t)n;
+
+    // The writer has closed its end.
+    if (n == 0)
+    {
+      Logging::cout() << "Reader finished" << Logging::endl;
+      r->done = true;
+      r->unwatch_io(r->fd);
+      close(r->fd);
+    }
+  }
+};
+
+void test_pipe(SystematicTestHarness* harness)
+{
+  received = 0;
+
+  int fds[2];
+  check(pipe(fds) == 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  int write_fd = fds[1];
+
+  schedule_lambda([harness, read_fd = fds[0], write_fd]() {
+    // The watch keeps the reader alive until it has read everything.
+    auto* r = new Reader(read_fd);
+    check(r->watch_io(read_fd, pal::Poller::Read));
+    Cown::release(ThreadAlloc::get(), r);
+
+    // Write in chunks with gaps, so that the runtime goes idle and waits for
+    // I/O in between.
+    harness->external_thread([write_fd]() {
+      char chunk[CHUNK_SIZE] = {};
+      for (size_t i = 0; i < CHUNKS; i++)
+      {
+        check(write(write_fd, chunk, sizeof(chunk)) == sizeof(chunk));
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      close(write_fd);
+    });
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_pipe, &harness);
+  check(received == CHUNKS * CHUNK_SIZE);
+
+  return 0;
+}
+#else
+int main()
+{
+  return 0;
+}
+#endif
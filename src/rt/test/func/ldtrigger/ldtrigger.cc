@@ -0,0 +1,79 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+/**
+ * Creates cycles of cowns that only the leak detector can collect, with the
+ * leak detector started automatically, and checks that cycles are collected
+ * while the runtime is still busy.
+ **/
+
+#include <test/harness.h>
+
+static constexpr size_t MAX_STEPS = 100'000;
+static constexpr size_t LD_COWNS = 64;
+
+static std::atomic<size_t> collected{0};
+
+struct Node : public VCown<Node>
+{
+  Node* other = nullptr;
+
+  ~Node()
+  {
+    collected++;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (other != nullptr)
+      st.push(other);
+  }
+};
+
+struct Driver : public VCown<Driver>
+{
+  size_t steps = 0;
+};
+
+void step(Driver* d)
+{
+  schedule_lambda(d, [d]() {
+    // A pair of cowns that refer to each other, and nothing else refers to.
+    auto* a = new Node;
+    auto* b = new Node;
+    a->other = b;
+    b->other = a;
+    Cown::acquire(a);
+    Cown::release(ThreadAlloc::get(), a);
+
+    if ((collected == 0) && (++d->steps < MAX_STEPS))
+    {
+      step(d);
+      return;
+    }
+
+    check(collected > 0);
+
+    SchedulerStatsSnapshot total;
+    for (auto& s : Scheduler::snapshot_stats())
+      total.add(s);
+    Logging::cout() << "Collected " << collected << " cowns in " << d->steps
+                    << " steps, " << total.lds << " LD cycles" << std::endl;
+
+    Cown::release(ThreadAlloc::get(), d);
+  });
+}
+
+void test_trigger()
+{
+  collected = 0;
+  Scheduler::set_ld_trigger(LD_COWNS);
+  step(new Driver);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  harness.run(test_trigger);
+  return 0;
+}
@@ -3,6 +3,7 @@
 #include "memory.h"
 
 #include "memory_alloc.h"
+#include "memory_compact.h"
 #include "memory_gc.h"
 #include "memory_iterator.h"
 #include "memory_merge.h"
@@ -59,6 +60,7 @@ int main(int argc, char** argv)
   memory_merge::run_test();
   memory_gc::run_test();
   memory_rc::run_test();
+  memory_compact::run_test();
   // memory_subregion::run_test();
 
   test_dealloc();
@@ -170,9 +170,88 @@ namespace memory_alloc
     }
   }
 
+  /**
+   * Arenas start small and grow geometrically, unless a size hint is given
+   * when the region is created.
+   **/
+  void test_arena_growth()
+  {
+    using C = C1;
+    using MC = MediumC2;
+    constexpr size_t min_size = RegionArena::MIN_ARENA_SIZE;
+    constexpr size_t max_size = RegionArena::MAX_ARENA_SIZE;
+
+    // A region with a few small objects needs only the smallest arena.
+    {
+      auto* o = new (RegionType::Arena) C;
+      {
+        UsingRegion rr(o);
+        for (size_t i = 0; i < 10; i++)
+          new C;
+        check(debug_size() == 11);
+      }
+      auto* reg = RegionArena::get(o);
+      check(reg->debug_arena_count() == 1);
+      check(reg->debug_arena_memory() == min_size);
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+    }
+
+    // Each arena is twice the size of the one before, up to a limit.
+    {
+      constexpr size_t n = 64 * 1024;
+      auto* o = new (RegionType::Arena) C;
+      {
+        UsingRegion rr(o);
+        for (size_t i = 0; i < n; i++)
+          new C;
+        check(debug_size() == n + 1);
+      }
+      auto* reg = RegionArena::get(o);
+      size_t count = reg->debug_arena_count();
+      size_t memory = reg->debug_arena_memory();
+      check(memory >= (n + 1) * vsizeof<C>);
+      check(memory < 2 * (n + 1) * vsizeof<C> + max_size);
+      check((min_size << (count - 1)) <= max_size);
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+    }
+
+    // An object larger than the next arena gets an arena that fits it.
+    {
+      auto* o = new (RegionType::Arena) C;
+      {
+        UsingRegion rr(o);
+        new MC;
+        check(debug_size() == 2);
+      }
+      auto* reg = RegionArena::get(o);
+      check(reg->debug_arena_count() == 2);
+      check(reg->debug_arena_memory() <= min_size + 2 * sizeof(MC));
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+    }
+
+    // A size hint reserves a first arena large enough for the objects.
+    {
+      constexpr size_t n = 1000;
+      auto* o = new (RegionType::Arena, (n + 1) * vsizeof<C>) C;
+      {
+        UsingRegion rr(o);
+        for (size_t i = 0; i < n; i++)
+          new C;
+        check(debug_size() == n + 1);
+      }
+      check(RegionArena::get(o)->debug_arena_count() == 1);
+      region_release(o);
+      snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+    }
+  }
+
   void run_test()
   {
     test_alloc<RegionType::Trace>();
     test_alloc<RegionType::Arena>();
+    test_arena_growth();
   }
 }
\ No newline at end of file
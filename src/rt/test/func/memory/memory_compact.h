@@ -0,0 +1,363 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+#pragma once
+
+#include "memory.h"
+
+namespace memory_compact
+{
+  /**
+   * An object that can be moved when its region is compacted.
+   **/
+  struct M : public V<M>
+  {
+    M* f1 = nullptr;
+    M* f2 = nullptr;
+    size_t value = 0;
+
+    M(size_t value = 0) : value(value) {}
+
+    void trace(ObjectStack& st) const
+    {
+      if (f1 != nullptr)
+        st.push(f1);
+
+      if (f2 != nullptr)
+        st.push(f2);
+    }
+
+    void relocate(ObjectRelocator& r)
+    {
+      r.update(f1);
+      r.update(f2);
+    }
+  };
+
+  /**
+   * A movable object with a destructor, so it lives in the other ring.
+   **/
+  struct MF : public V<MF>
+  {
+    M* m = nullptr;
+    MF* next = nullptr;
+
+    void trace(ObjectStack& st) const
+    {
+      if (m != nullptr)
+        st.push(m);
+
+      if (next != nullptr)
+        st.push(next);
+    }
+
+    void relocate(ObjectRelocator& r)
+    {
+      r.update(m);
+      r.update(next);
+    }
+
+    MF()
+    {
+      live_count++;
+    }
+
+    ~MF()
+    {
+      live_count--;
+    }
+  };
+
+  /// Builds a list of `n` objects from `o`, with garbage in between.
+  void make_list(M* o, size_t n)
+  {
+    M* p = o;
+    for (size_t i = 1; i <= n; i++)
+    {
+      new M; // some garbage
+      p->f1 = new M(i);
+      p = p->f1;
+    }
+  }
+
+  void check_list(M* o, size_t n)
+  {
+    M* p = o->f1;
+    for (size_t i = 1; i <= n; i++)
+    {
+      check(p != nullptr);
+      check(p->value == i);
+      p = p->f1;
+    }
+    check(p == nullptr);
+  }
+
+  /**
+   * The live objects are packed together after a compaction, in the order
+   * they are reached, and the garbage is gone.
+   **/
+  void test_list()
+  {
+    constexpr size_t n = 100;
+    auto* o = new (RegionType::Trace) M;
+    {
+      UsingRegion rr(o);
+      make_list(o, n);
+      check(debug_size() == 2 * n + 1);
+
+      region_compact();
+      check(debug_size() == n + 1);
+      check_list(o, n);
+
+      // Each object directly follows the one before it.
+      M* p = o->f1;
+      while (p->f1 != nullptr)
+      {
+        check((std::byte*)p->f1 == (std::byte*)p + vsizeof<M>);
+        p = p->f1;
+      }
+
+      // Compacting again moves the objects out of the old chunk.
+      M* first = o->f1;
+      o->f1->f2 = o->f1->f1->f1;
+      o->f1->f1 = nullptr;
+      region_compact();
+      check(debug_size() == n);
+      check(o->f1 != first);
+      check(o->f1->f2->value == 3);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * Objects with destructors are destroyed once, whether collected from a
+   * chunk or released with the region.
+   **/
+  void test_destructors()
+  {
+    auto* o = new (RegionType::Trace) MF;
+    {
+      UsingRegion rr(o);
+      auto* a = new MF;
+      auto* b = new MF;
+      new MF; // some garbage
+      o->next = a;
+      a->next = b;
+      b->m = new M(7);
+      a->m = b->m;
+      check(live_count == 4);
+
+      region_compact();
+      check(live_count == 3);
+      check(debug_size() == 4);
+
+      // Drop an object that lives in the chunk.
+      o->next->next = nullptr;
+      region_collect();
+      check(live_count == 2);
+      check(debug_size() == 3);
+      check(o->next->m->value == 7);
+    }
+    region_release(o);
+    check(live_count == 0);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * External references follow the objects they refer to.
+   **/
+  void test_ext_ref()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) M;
+    {
+      UsingRegion rr(o);
+      make_list(o, 10);
+      M* p = o->f1->f1->f1;
+      auto* ext = create_external_reference(p);
+
+      region_compact();
+      check(is_external_reference_valid(ext));
+      M* q = (M*)use_external_reference(ext);
+      check(q != p);
+      check(q == o->f1->f1->f1);
+      check(q->value == 3);
+
+      o->f1->f1->f1 = nullptr;
+      region_collect();
+      check(!is_external_reference_valid(ext));
+      Immutable::release(alloc, ext);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * A region with an object that cannot be moved is only collected.
+   **/
+  void test_unmovable()
+  {
+    auto* o = new (RegionType::Trace) M;
+    {
+      UsingRegion rr(o);
+      make_list(o, 10);
+      M* p = o->f1;
+      auto* c = new C1;
+      o->f2 = (M*)(Object*)c;
+
+      region_compact();
+      check(debug_size() == 12);
+      check(o->f1 == p);
+      check_list(o, 10);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * Compacted regions can be merged and frozen.
+   **/
+  void test_merge_freeze()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) M;
+    auto* r = new (RegionType::Trace) M(100);
+    {
+      UsingRegion rr(r);
+      make_list(r, 5);
+      region_compact();
+    }
+    {
+      UsingRegion rr(o);
+      make_list(o, 5);
+      region_compact();
+      o->f2 = r;
+      merge(r);
+      check(debug_size() == 12);
+    }
+
+    o = freeze(o);
+    check_list(o, 5);
+    check(o->f2->value == 100);
+    check_list(o->f2, 5);
+    Immutable::release(alloc, o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * A compacted region can be frozen after objects that cannot be moved are
+   * added to it, or merged into it.  The objects they refer to are left in
+   * their chunk, which is deallocated once they are released.
+   **/
+  void test_freeze_unmovable()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) M;
+    auto* r = new (RegionType::Trace) C1;
+    {
+      UsingRegion rr(r);
+      r->f1 = new C1;
+    }
+
+    C1* c;
+    M* first;
+    M* pinned;
+    {
+      UsingRegion rr(o);
+      make_list(o, 5);
+      region_compact();
+      first = o->f1;
+      pinned = o->f1->f1;
+
+      c = new C1;
+      c->f1 = (C1*)(Object*)pinned;
+      o->f2 = (M*)(Object*)c;
+
+      merge(r);
+      c->f2 = r;
+    }
+
+    o = freeze(o);
+    check_list(o, 5);
+    check(o->f1 != first);
+    check(o->f1->f1 == pinned);
+    check(c->f1 == (C1*)(Object*)pinned);
+    check(c->f2->f1 != nullptr);
+    Immutable::release(alloc, o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * Objects left in their chunk by freezing may be unreachable, in which
+   * case they are deallocated by the freeze, along with the chunk.
+   **/
+  void test_freeze_unreachable_unmovable()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) M;
+    {
+      UsingRegion rr(o);
+      make_list(o, 5);
+      region_compact();
+
+      auto* c = new C1;
+      c->f1 = (C1*)(Object*)o->f1;
+      o->f1 = nullptr;
+    }
+
+    o = freeze(o);
+    check(o->f1 == nullptr);
+    Immutable::release(alloc, o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * A compacted region can be frozen after an object in a chunk has been
+   * made its root.  The root is left in its chunk.
+   **/
+  void test_freeze_swapped_root()
+  {
+    auto& alloc = ThreadAlloc::get();
+    auto* o = new (RegionType::Trace) M;
+    M* root;
+    {
+      UsingRegion rr(o);
+      make_list(o, 5);
+      region_compact();
+
+      root = o->f1;
+      o->f1 = nullptr;
+      root->f2 = o;
+      set_entry_point(root);
+
+      // The root stays in its chunk, and the rest move to a new one.
+      region_compact();
+      check(debug_size() == 6);
+    }
+
+    root = freeze(root);
+    check(root->f2->value == 0);
+    check(root->f2->f1 == nullptr);
+    M* p = root;
+    for (size_t i = 1; i <= 5; i++)
+    {
+      check(p->value == i);
+      p = p->f1;
+    }
+    check(p == nullptr);
+    Immutable::release(alloc, root);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  void run_test()
+  {
+    test_list();
+    test_destructors();
+    test_ext_ref();
+    test_unmovable();
+    test_merge_freeze();
+    test_freeze_unmovable();
+    test_freeze_unreachable_unmovable();
+    test_freeze_swapped_root();
+  }
+}
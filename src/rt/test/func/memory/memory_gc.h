@@ -564,6 +564,104 @@ namespace memory_gc
     snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
   }
 
+  /**
+   * A region set to be collected automatically is collected when it is
+   * closed, once it has grown enough, but not while it is still open.
+   **/
+  void test_auto_gc()
+  {
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+      region_auto_gc(100);
+      o->f1 = new C;
+    }
+
+    // Allocate more than enough garbage to trigger a collection every few
+    // times the region is opened.
+    constexpr size_t rounds = 100;
+    constexpr size_t garbage = 1000;
+    for (size_t i = 0; i < rounds; i++)
+    {
+      UsingRegion rr(o);
+      for (size_t j = 0; j < garbage; j++)
+        new C;
+    }
+
+    {
+      UsingRegion rr(o);
+      check(debug_size() >= 2);
+      check(debug_size() < rounds * garbage / 4);
+      check(o->f1 != nullptr);
+
+      // A region open further down is not collected when closed.
+      region_collect();
+      for (size_t j = 0; j < rounds * garbage / 4; j++)
+        new C;
+      {
+        UsingRegion rr2(o);
+      }
+      check(debug_size() == 2 + rounds * garbage / 4);
+
+      region_auto_gc(0);
+    }
+
+    {
+      UsingRegion rr(o);
+      check(debug_size() == 2 + rounds * garbage / 4);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
+  /**
+   * Objects collected from a region that pools their type are reused by
+   * later allocations in it.
+   **/
+  void test_pool()
+  {
+    auto* o = new (RegionType::Trace) C;
+    {
+      UsingRegion rr(o);
+      check(region_pool(C::desc(), 2));
+
+      C* a = new C;
+      C* b = new C;
+      C* c = new C;
+      region_collect();
+      check(debug_size() == 1);
+
+      // Two of the three are kept, and reused.
+      C* d = new C;
+      C* e = new C;
+      C* f = new C;
+      check((d == a) || (d == b) || (d == c));
+      check((e == a) || (e == b) || (e == c));
+      check(d != e);
+
+      o->f1 = d;
+      d->f1 = e;
+      e->f1 = f;
+      region_collect();
+      check(debug_size() == 4);
+
+      // Only a few types can be pooled in each region.
+      check(region_pool(F::desc()));
+      check(region_pool(Cx::desc()));
+      check(region_pool(Fx::desc()));
+      check(!region_pool(MC::desc()));
+
+      check(region_pool(F::desc(), 0));
+      check(region_pool(MC::desc()));
+
+      o->f1 = nullptr;
+      region_collect();
+      check(debug_size() == 1);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
   void run_test()
   {
     test_basic();
@@ -573,5 +671,7 @@ namespace memory_gc
     test_cycles();
     test_merge();
     test_swap_root();
+    test_auto_gc();
+    test_pool();
   }
 }
\ No newline at end of file
@@ -41,6 +41,8 @@ namespace memory_rc
 
       {
         UsingRegion rc(o);
+        // Has no effect, objects are freed as soon as they are unreachable.
+        region_auto_gc(100);
 
         auto* o1 = new C;
         auto* o2 = new C;
@@ -294,9 +296,38 @@ namespace memory_rc
     snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
   }
 
+  /**
+   * Objects freed from a region that pools their type are reused by later
+   * allocations in it.
+   **/
+  void test_pool()
+  {
+    auto* o = new (RegionType::Rc) C;
+    {
+      UsingRegion rc(o);
+      check(region_pool(C::desc()));
+
+      auto* o1 = new C;
+      auto* o2 = new C;
+      o1->f1 = o2;
+      decref(o1);
+
+      auto* o3 = new C;
+      auto* o4 = new C;
+      check((o3 == o1) || (o3 == o2));
+      check((o4 == o1) || (o4 == o2));
+      o->f1 = o3;
+      o->f2 = o4;
+      check(debug_size() == 3);
+    }
+    region_release(o);
+    snmalloc::debug_check_empty<snmalloc::Alloc::StateHandle>();
+  }
+
   void run_test()
   {
     test_basic();
     test_cycles();
+    test_pool();
   }
 }
@@ -0,0 +1,200 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+static constexpr size_t STEPS = 100;
+static constexpr size_t BUSY = 8;
+static constexpr size_t POLLS = 100'000;
+static constexpr size_t NORMAL = 16;
+
+static size_t cores = 0;
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+};
+
+/// Checks that a behaviour on `c` runs on the thread it is pinned to.
+void check_thread(Counter* c)
+{
+  if (c->get_pinned() != nullptr)
+    check(Scheduler::local() == c->get_pinned());
+}
+
+void step(Counter* c)
+{
+  schedule_lambda(c, [c]() {
+    check_thread(c);
+    if (++c->count < STEPS)
+      step(c);
+    else
+      Cown::release(ThreadAlloc::get(), c);
+  });
+}
+
+void step_pair(Counter* pinned, Counter* other, size_t remaining)
+{
+  Cown* cowns[2] = {pinned, other};
+  schedule_lambda(cowns, [=]() {
+    check_thread(pinned);
+    if (remaining > 1)
+    {
+      step_pair(pinned, other, remaining - 1);
+      return;
+    }
+
+    auto& alloc = ThreadAlloc::get();
+    Cown::release(alloc, pinned);
+    Cown::release(alloc, other);
+  });
+}
+
+void test_pinned()
+{
+  // Pin a cown to each thread, and keep the threads busy with unpinned cowns,
+  // so that there is work to steal.
+  for (size_t i = 0; i < cores; i++)
+  {
+    auto* c = new Counter;
+    c->pin(i);
+    step(c);
+  }
+
+  for (size_t i = 0; i < BUSY; i++)
+    step(new Counter);
+
+  // Behaviours on a pinned and an unpinned cown run on the pinned thread.
+  auto* pinned = new Counter;
+  pinned->pin(cores - 1);
+  step_pair(pinned, new Counter, STEPS);
+}
+
+void test_external(SystematicTestHarness* harness)
+{
+  // Schedule a pinned cown from a thread outside the runtime.
+  schedule_lambda([harness]() {
+    auto* c = new Counter;
+    c->pin(0);
+    Scheduler::add_external_event_source();
+
+    harness->external_thread([c]() {
+      for (size_t i = 0; i < STEPS; i++)
+      {
+        schedule_lambda(c, [c]() {
+          check_thread(c);
+          c->count++;
+        });
+      }
+
+      schedule_lambda<YesTransfer>(c, [c]() {
+        check_thread(c);
+        check(c->count == STEPS);
+        Scheduler::remove_external_event_source();
+      });
+    });
+  });
+}
+
+static std::atomic<size_t> pinned_runs{0};
+static std::atomic<size_t> normal_runs{0};
+
+void test_priority()
+{
+  // With a single scheduler thread, a pinned cown that is high priority runs
+  // ahead of pinned cowns that are not, and the pinned cowns that are not
+  // take turns with unpinned cowns, rather than all running first.
+  schedule_lambda([]() {
+    pinned_runs = 0;
+    normal_runs = 0;
+
+    for (size_t i = 0; i < NORMAL; i++)
+    {
+      auto* c = new Counter;
+      c->pin(0);
+      schedule_lambda<YesTransfer>(c, []() { pinned_runs++; });
+      schedule_lambda<YesTransfer>(new Counter, []() {
+        if (cores == 1)
+          check(pinned_runs <= 2 * ++normal_runs);
+      });
+    }
+
+    auto* urgent = new Counter;
+    urgent->pin(0);
+    urgent->set_priority(Priority::High);
+    schedule_lambda<YesTransfer>(urgent, [urgent]() {
+      check_thread(urgent);
+      if (cores == 1)
+        check(pinned_runs == 0);
+    });
+  });
+}
+
+struct Node : public VCown<Node>
+{
+  inline static std::atomic<size_t> live{0};
+
+  Node* other = nullptr;
+
+  Node()
+  {
+    live++;
+  }
+
+  ~Node()
+  {
+    live--;
+  }
+
+  void trace(ObjectStack& st) const
+  {
+    if (other != nullptr)
+      st.push(other);
+  }
+};
+
+/// Runs the leak detector until the `Node`s are collected.
+void poll_collected(Counter* poll, size_t remaining)
+{
+  schedule_lambda(poll, [poll, remaining]() {
+    if (Node::live == 0)
+    {
+      Cown::release(ThreadAlloc::get(), poll);
+      Scheduler::remove_external_event_source();
+      return;
+    }
+
+    check(remaining > 0);
+    Scheduler::want_ld();
+    poll_collected(poll, remaining - 1);
+  });
+}
+
+void test_ld()
+{
+  // A pinned cown in an unreachable cycle is collected by the leak detector
+  // while the runtime is running, rather than only at teardown.
+  schedule_lambda([]() {
+    auto* a = new Node;
+    auto* b = new Node;
+    a->pin(0);
+    a->other = b;
+    b->other = a;
+
+    Scheduler::add_external_event_source();
+    poll_collected(new Counter, POLLS);
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  cores = harness.cores;
+
+  harness.run(test_pinned);
+  harness.run(test_external, &harness);
+  harness.run(test_priority);
+  harness.run(test_ld);
+
+  return 0;
+}
@@ -0,0 +1,75 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+static constexpr size_t NORMAL = 50;
+static constexpr size_t STEPS = 200;
+
+static size_t cores = 0;
+static std::atomic<size_t> normal_runs{0};
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+};
+
+void test_ahead()
+{
+  normal_runs = 0;
+
+  // Schedule a batch of normal priority cowns, and then a high priority
+  // cown.  With a single scheduler thread, the high priority cown must run
+  // before any of the normal priority cowns.
+  schedule_lambda([]() {
+    for (size_t i = 0; i < NORMAL; i++)
+      schedule_lambda<YesTransfer>(new Counter, []() { normal_runs++; });
+
+    auto* urgent = new Counter;
+    urgent->set_priority(Priority::High);
+    schedule_lambda<YesTransfer>(urgent, []() {
+      if (cores == 1)
+        check(normal_runs == 0);
+    });
+  });
+}
+
+void step(Counter* c)
+{
+  schedule_lambda(c, [c]() {
+    if (++c->count < STEPS)
+      step(c);
+    else
+      Cown::release(ThreadAlloc::get(), c);
+  });
+}
+
+void test_starvation()
+{
+  normal_runs = 0;
+
+  // High priority cowns that keep rescheduling themselves must not stop the
+  // normal priority cowns from running.
+  schedule_lambda([]() {
+    for (size_t i = 0; i < 2; i++)
+    {
+      auto* c = new Counter;
+      c->set_priority(Priority::High);
+      step(c);
+    }
+
+    for (size_t i = 0; i < NORMAL; i++)
+      schedule_lambda<YesTransfer>(new Counter, []() { normal_runs++; });
+  });
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  cores = harness.cores;
+
+  harness.run(test_ahead);
+  harness.run(test_starvation);
+
+  return 0;
+}
@@ -136,6 +136,180 @@ void promise_transfer2()
   auto rp2 = Promise<int>::PromiseR(p2, YesTransfer);
 }
 
+void promise_timeout()
+{
+  auto pp = Promise<int>::create_promise();
+  auto rp = std::move(pp.first);
+  auto wp = std::move(pp.second);
+
+  schedule_lambda_after(50'000'000, [wp = std::move(wp)]() mutable {
+    schedule_lambda([wp = std::move(wp)]() mutable {
+      Promise<int>::fulfill(std::move(wp), 42);
+    });
+  });
+
+  // Times out before the promise is fulfilled.
+  rp.then_with_timeout(
+    std::chrono::milliseconds(1),
+    [](std::variant<int, Promise<int>::PromiseErr> val) {
+      check(std::holds_alternative<Promise<int>::PromiseErr>(val));
+      check(
+        std::get<Promise<int>::PromiseErr>(val).code() ==
+        Promise<int>::PromiseErr::TIMEOUT);
+    });
+
+  // Fulfilled before it times out.
+  rp.then_with_timeout(
+    std::chrono::milliseconds(200),
+    [](std::variant<int, Promise<int>::PromiseErr> val) {
+      check(std::holds_alternative<int>(val));
+      check(std::get<int>(val) == 42);
+    });
+
+  // Once fulfilled, its timer no longer keeps the runtime running.
+  rp.then_with_timeout(
+    std::chrono::hours(1),
+    [](std::variant<int, Promise<int>::PromiseErr> val) {
+      check(std::holds_alternative<int>(val));
+    });
+}
+
+void promise_cancel()
+{
+  auto pp = Promise<int>::create_promise();
+  auto rp = std::move(pp.first);
+  auto wp = std::move(pp.second);
+
+  // Cancelling frees the continuation straight away.
+  auto captured = std::make_shared<int>(0);
+  std::weak_ptr<int> weak = captured;
+  auto timeout = rp.then_with_timeout(
+    std::chrono::milliseconds(1),
+    [captured = std::move(captured)](
+      std::variant<int, Promise<int>::PromiseErr>) { abort(); });
+
+  check(!timeout.is_done());
+  check(timeout.cancel());
+  check(timeout.is_done());
+  check(weak.expired());
+  check(!timeout.cancel());
+
+  // Nor does a cancelled timer.
+  auto later = rp.then_with_timeout(
+    std::chrono::hours(1),
+    [](std::variant<int, Promise<int>::PromiseErr>) { abort(); });
+  check(later.cancel());
+
+  // Breaking the promise after cancelling does not run the continuation.
+  schedule_lambda([wp = std::move(wp)]() {});
+}
+
+static constexpr size_t FAN_OUT = 50;
+
+void promise_when_all()
+{
+  std::vector<Promise<int>::PromiseR> readers;
+  for (size_t i = 0; i < FAN_OUT; i++)
+  {
+    auto pp = Promise<int>::create_promise();
+    readers.push_back(std::move(pp.first));
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      Promise<int>::fulfill(std::move(wp), (int)i);
+    });
+  }
+
+  Promise<int>::when_all(readers).then(
+    [](std::variant<std::vector<int>, Promise<std::vector<int>>::PromiseErr>
+         val) {
+      check(std::holds_alternative<std::vector<int>>(val));
+      auto& values = std::get<std::vector<int>>(val);
+      check(values.size() == FAN_OUT);
+      for (size_t i = 0; i < FAN_OUT; i++)
+        check(values[i] == (int)i);
+    });
+}
+
+void promise_when_all_broken()
+{
+  std::vector<Promise<int>::PromiseR> readers;
+  for (size_t i = 0; i < FAN_OUT; i++)
+  {
+    auto pp = Promise<int>::create_promise();
+    readers.push_back(std::move(pp.first));
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      if (i != FAN_OUT / 2)
+        Promise<int>::fulfill(std::move(wp), (int)i);
+    });
+  }
+
+  Promise<int>::when_all(readers).then(
+    [](std::variant<std::vector<int>, Promise<std::vector<int>>::PromiseErr>
+         val) {
+      check(std::holds_alternative<Promise<std::vector<int>>::PromiseErr>(val));
+    });
+}
+
+void promise_when_all_bool()
+{
+  std::vector<Promise<bool>::PromiseR> readers;
+  for (size_t i = 0; i < FAN_OUT; i++)
+  {
+    auto pp = Promise<bool>::create_promise();
+    readers.push_back(std::move(pp.first));
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      Promise<bool>::fulfill(std::move(wp), i % 2 == 1);
+    });
+  }
+
+  // Each value is written by a different continuation, so they must not
+  // share a word, as they would in a `std::vector<bool>`.
+  Promise<bool>::when_all(readers).then(
+    [](std::variant<std::vector<bool>, Promise<std::vector<bool>>::PromiseErr>
+         val) {
+      check(std::holds_alternative<std::vector<bool>>(val));
+      auto& values = std::get<std::vector<bool>>(val);
+      check(values.size() == FAN_OUT);
+      for (size_t i = 0; i < FAN_OUT; i++)
+        check(values[i] == (i % 2 == 1));
+    });
+}
+
+void promise_when_any()
+{
+  std::vector<Promise<int>::PromiseR> readers;
+  for (size_t i = 0; i < FAN_OUT; i++)
+  {
+    auto pp = Promise<int>::create_promise();
+    readers.push_back(std::move(pp.first));
+    // Only the odd promises are fulfilled, the others are broken.
+    schedule_lambda([i, wp = std::move(pp.second)]() mutable {
+      if (i % 2 == 1)
+        Promise<int>::fulfill(std::move(wp), (int)i * 10);
+    });
+  }
+
+  using Result = std::pair<size_t, int>;
+  Promise<int>::when_any(readers).then(
+    [](std::variant<Result, Promise<Result>::PromiseErr> val) {
+      check(std::holds_alternative<Result>(val));
+      auto& [index, value] = std::get<Result>(val);
+      check(index % 2 == 1);
+      check(value == (int)index * 10);
+    });
+
+  std::vector<Promise<int>::PromiseR> none;
+  Promise<int>::when_any(none).then(
+    [](std::variant<Result, Promise<Result>::PromiseErr> val) {
+      check(std::holds_alternative<Promise<Result>::PromiseErr>(val));
+    });
+}
+
+// Timers can only be added from a scheduler thread.
+void run_in_runtime(void (*test)())
+{
+  schedule_lambda(test);
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
@@ -145,6 +319,12 @@ int main(int argc, char** argv)
   harness.run(promise_no_writer);
   harness.run(promise_smart_pointer);
   harness.run(promise_transfer2);
+  harness.run(run_in_runtime, promise_timeout);
+  harness.run(run_in_runtime, promise_cancel);
+  harness.run(promise_when_all);
+  harness.run(promise_when_all_broken);
+  harness.run(promise_when_all_bool);
+  harness.run(promise_when_any);
 
   return 0;
 }
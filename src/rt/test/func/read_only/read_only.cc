@@ -0,0 +1,96 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <test/harness.h>
+
+static constexpr size_t ROUNDS = 20;
+static constexpr size_t READERS = 8;
+
+struct Counter
+{
+  size_t value = 0;
+};
+
+// Number of behaviours currently reading or writing the counter.
+static std::atomic<size_t> readers{0};
+static std::atomic<size_t> writers{0};
+static std::atomic<size_t> reads{0};
+
+void test_readers_and_writers()
+{
+  auto c = make_cown<Counter>();
+  reads = 0;
+
+  // Each round writes the counter, then reads it several times.  The reads
+  // must see the write before them, and no write may overlap a read.
+  for (size_t round = 1; round <= ROUNDS; round++)
+  {
+    when(c) << [round](acquired_cown<Counter> c) {
+      check(readers == 0);
+      check(writers++ == 0);
+      check(c->value == round - 1);
+      yield();
+      c->value = round;
+      writers--;
+    };
+
+    for (size_t i = 0; i < READERS; i++)
+    {
+      when(read(c)) << [round](acquired_cown<const Counter> c) {
+        readers++;
+        check(writers == 0);
+        check(c->value == round);
+        yield();
+        readers--;
+        reads++;
+      };
+    }
+  }
+
+  when(c) << [](acquired_cown<Counter> c) {
+    check(readers == 0);
+    check(c->value == ROUNDS);
+    check(reads == ROUNDS * READERS);
+  };
+}
+
+void test_read_and_write()
+{
+  auto src = make_cown<Counter>();
+  auto dsts = std::vector<cown_ptr<Counter>>();
+  for (size_t i = 0; i < 4; i++)
+    dsts.push_back(make_cown<Counter>());
+
+  when(src) << [](acquired_cown<Counter> src) { src->value = 5; };
+
+  // Several behaviours read the same source while each writes its own
+  // destination.
+  for (size_t round = 0; round < ROUNDS; round++)
+  {
+    for (auto& dst : dsts)
+    {
+      when(read(src), dst) <<
+        [](acquired_cown<const Counter> src, acquired_cown<Counter> dst) {
+          dst->value += src->value;
+        };
+    }
+  }
+
+  for (auto& dst : dsts)
+  {
+    when(dst, src) << [](acquired_cown<Counter> dst, acquired_cown<Counter>) {
+      check(dst->value == 5 * ROUNDS);
+    };
+  }
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(test_readers_and_writers);
+  harness.run(test_read_and_write);
+
+  return 0;
+}
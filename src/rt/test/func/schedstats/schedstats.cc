@@ -0,0 +1,55 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <test/harness.h>
+
+struct Counter : public VCown<Counter>
+{
+  size_t count = 0;
+};
+
+static constexpr size_t STEPS = 50;
+static size_t cores = 0;
+
+void step(Counter* c)
+{
+  // Each step is sent from the previous one, so runs in a later batch on
+  // this cown, and all earlier batches have been recorded.
+  schedule_lambda(c, [c]() {
+    c->count++;
+
+    if (c->count < STEPS)
+    {
+      step(c);
+      return;
+    }
+
+    auto stats = Scheduler::snapshot_stats();
+    check(stats.size() == cores);
+
+    SchedulerStatsSnapshot total;
+    for (auto& s : stats)
+      total.add(s);
+
+    check(total.behaviours >= STEPS - 1);
+    check(total.batches >= STEPS - 1);
+    check(total.fifo + total.lifo >= 1);
+
+    total.print(std::cout);
+
+    Cown::release(ThreadAlloc::get(), c);
+  });
+}
+
+void test_snapshot()
+{
+  step(new Counter);
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+  cores = harness.cores;
+  harness.run(test_snapshot);
+  return 0;
+}
@@ -5,7 +5,17 @@
 
 struct Runner : public VCown<Runner>
 {
+  size_t runs = 0;
+
   Runner() {}
+
+  ~Runner()
+  {
+    // Each runner is sent one behaviour, which must run exactly once, however
+    // the runner is moved between threads.  Every runner is deallocated by
+    // the end of the test, so this also catches a runner lost by a steal.
+    check(runs == 1);
+  }
 };
 
 void schedule_run(size_t decay);
@@ -19,6 +29,7 @@ struct Run : public VBehaviour<Run>
 
   void f()
   {
+    r->runs++;
     schedule_run(decay);
   }
 };
@@ -44,9 +55,36 @@ void basic_test(size_t cores)
   }
 }
 
+struct Fanout : public VBehaviour<Fanout>
+{
+  Runner* r;
+  size_t width;
+
+  Fanout(Runner* r, size_t width) : r(r), width(width) {}
+
+  void f()
+  {
+    r->runs++;
+
+    // Builds a deep queue on this thread, so the other threads take several
+    // cowns from it at once.
+    for (size_t i = 0; i < width; i++)
+      schedule_run(2);
+  }
+};
+
+void batch_test(size_t width)
+{
+  auto& alloc = ThreadAlloc::get();
+  auto runner = new Runner();
+  Cown::schedule<Fanout>(runner, runner, width);
+  Cown::release(alloc, runner);
+}
+
 int main(int argc, char** argv)
 {
   SystematicTestHarness harness(argc, argv);
   harness.run(basic_test, harness.cores);
+  harness.run(batch_test, (size_t)100);
   return 0;
 }
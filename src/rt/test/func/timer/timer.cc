@@ -0,0 +1,100 @@
+// Copyright Microsoft and Project Verona Contributors.
+// SPDX-License-Identifier: MIT
+
+#include <cpp/when.h>
+#include <test/harness.h>
+
+using namespace std::chrono_literals;
+using verona::rt::TimerWheel;
+
+static constexpr size_t TIMERS = 10;
+static constexpr size_t TICKS = 5;
+
+struct Log
+{
+  size_t fired = 0;
+};
+
+void test_after()
+{
+  auto log = make_cown<Log>();
+
+  // Timers with later deadlines are added first, so they must be ordered by
+  // the wheel rather than by when they were added.  They are two ticks
+  // apart, so that each is due in a tick of its own.
+  for (size_t i = TIMERS; i > 0; i--)
+  {
+    uint64_t deadline = TimerWheel::now() + i * 2 * TimerWheel::RESOLUTION;
+    when_after(std::chrono::milliseconds(i * 2), log)
+      << [i, deadline](acquired_cown<Log> log) {
+           check(TimerWheel::now() >= deadline);
+           check(log->fired++ == i - 1);
+         };
+  }
+
+  // A timer beyond the lowest level of the wheel.
+  uint64_t deadline = TimerWheel::now() + 100'000'000;
+  when_after(100ms, log) << [deadline](acquired_cown<Log> log) {
+    check(TimerWheel::now() >= deadline);
+    check(log->fired++ == TIMERS);
+  };
+}
+
+void test_every()
+{
+  auto log = make_cown<Log>();
+
+  // Each behaviour runs no earlier than its own period, but may run late.
+  uint64_t start = TimerWheel::now();
+  when_every(2ms, log) << [start](acquired_cown<Log> log) {
+    check(TimerWheel::now() >= start + (log->fired + 1) * 2'000'000);
+    return ++log->fired < TICKS;
+  };
+
+  when_after(10ms) << [log]() {
+    when(log) << [](acquired_cown<Log> log) { check(log->fired > 0); };
+  };
+}
+
+struct State
+{
+  inline static std::atomic<size_t> live{0};
+
+  State()
+  {
+    live++;
+  }
+
+  ~State()
+  {
+    live--;
+  }
+};
+
+void test_ld()
+{
+  // The pending timer holds the only reference to the cown, so the leak
+  // detector must not collect it.
+  when_after(20ms, make_cown<State>()) << [](acquired_cown<State>) {
+    check(State::live == 1);
+  };
+
+  Scheduler::want_ld();
+}
+
+// Timers can only be added from a scheduler thread.
+void run_in_runtime(void (*test)())
+{
+  when() << test;
+}
+
+int main(int argc, char** argv)
+{
+  SystematicTestHarness harness(argc, argv);
+
+  harness.run(run_in_runtime, test_after);
+  harness.run(run_in_runtime, test_every);
+  harness.run(run_in_runtime, test_ld);
+
+  return 0;
+}